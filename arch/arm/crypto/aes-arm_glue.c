@@ -0,0 +1,253 @@
+/*
+ * Glue code for the ARM assembler AES implementation.
+ *
+ * The block functions use the tables and key schedule of aes_generic.c,
+ * so key setup is crypto_aes_set_key().  Besides the plain "aes" cipher,
+ * CBC and CTR are provided as blkciphers that call the assembler for
+ * every block directly instead of through the cbc/ctr templates' cipher
+ * indirection.  All three require word aligned data (cra_alignmask 3);
+ * the crypto layer bounces anything else.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <crypto/aes.h>
+#include <crypto/algapi.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/string.h>
+
+asmlinkage void aes_arm_encrypt(const u32 *key_enc, int rounds,
+				const u8 *in, u8 *out);
+asmlinkage void aes_arm_decrypt(const u32 *key_dec, int rounds,
+				const u8 *in, u8 *out);
+
+static inline int aes_arm_rounds(const struct crypto_aes_ctx *ctx)
+{
+	return 6 + ctx->key_length / 4;
+}
+
+static void aes_encrypt(struct crypto_tfm *tfm, u8 *dst, const u8 *src)
+{
+	struct crypto_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	aes_arm_encrypt(ctx->key_enc, aes_arm_rounds(ctx), src, dst);
+}
+
+static void aes_decrypt(struct crypto_tfm *tfm, u8 *dst, const u8 *src)
+{
+	struct crypto_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	aes_arm_decrypt(ctx->key_dec, aes_arm_rounds(ctx), src, dst);
+}
+
+static int cbc_encrypt(struct blkcipher_desc *desc,
+		       struct scatterlist *dst, struct scatterlist *src,
+		       unsigned int nbytes)
+{
+	struct crypto_aes_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	int rounds = aes_arm_rounds(ctx);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *in = walk.src.virt.addr;
+		u8 *out = walk.dst.virt.addr;
+		u8 *iv = walk.iv;
+
+		do {
+			crypto_xor(iv, in, AES_BLOCK_SIZE);
+			aes_arm_encrypt(ctx->key_enc, rounds, iv, out);
+			memcpy(iv, out, AES_BLOCK_SIZE);
+
+			in += AES_BLOCK_SIZE;
+			out += AES_BLOCK_SIZE;
+		} while ((nbytes -= AES_BLOCK_SIZE) >= AES_BLOCK_SIZE);
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int cbc_decrypt(struct blkcipher_desc *desc,
+		       struct scatterlist *dst, struct scatterlist *src,
+		       unsigned int nbytes)
+{
+	struct crypto_aes_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	int rounds = aes_arm_rounds(ctx);
+	struct blkcipher_walk walk;
+	u32 last[AES_BLOCK_SIZE / sizeof(u32)];
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *in = walk.src.virt.addr;
+		u8 *out = walk.dst.virt.addr;
+		u8 *iv = walk.iv;
+
+		do {
+			/* in and out may be the same block */
+			memcpy(last, in, AES_BLOCK_SIZE);
+			aes_arm_decrypt(ctx->key_dec, rounds, in, out);
+			crypto_xor(out, iv, AES_BLOCK_SIZE);
+			memcpy(iv, last, AES_BLOCK_SIZE);
+
+			in += AES_BLOCK_SIZE;
+			out += AES_BLOCK_SIZE;
+		} while ((nbytes -= AES_BLOCK_SIZE) >= AES_BLOCK_SIZE);
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int ctr_crypt(struct blkcipher_desc *desc,
+		     struct scatterlist *dst, struct scatterlist *src,
+		     unsigned int nbytes)
+{
+	struct crypto_aes_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	int rounds = aes_arm_rounds(ctx);
+	struct blkcipher_walk walk;
+	u32 ks[AES_BLOCK_SIZE / sizeof(u32)];
+	u8 *keystream = (u8 *)ks;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AES_BLOCK_SIZE);
+
+	while ((nbytes = walk.nbytes) >= AES_BLOCK_SIZE) {
+		u8 *in = walk.src.virt.addr;
+		u8 *out = walk.dst.virt.addr;
+
+		do {
+			aes_arm_encrypt(ctx->key_enc, rounds, walk.iv, keystream);
+			if (out != in)
+				memcpy(out, in, AES_BLOCK_SIZE);
+			crypto_xor(out, keystream, AES_BLOCK_SIZE);
+			crypto_inc(walk.iv, AES_BLOCK_SIZE);
+
+			in += AES_BLOCK_SIZE;
+			out += AES_BLOCK_SIZE;
+		} while ((nbytes -= AES_BLOCK_SIZE) >= AES_BLOCK_SIZE);
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	if (walk.nbytes) {
+		/* final partial block */
+		aes_arm_encrypt(ctx->key_enc, rounds, walk.iv, keystream);
+		crypto_xor(keystream, walk.src.virt.addr, nbytes);
+		memcpy(walk.dst.virt.addr, keystream, nbytes);
+		crypto_inc(walk.iv, AES_BLOCK_SIZE);
+		err = blkcipher_walk_done(desc, &walk, 0);
+	}
+
+	return err;
+}
+
+static struct crypto_alg aes_algs[] = { {
+	.cra_name		= "aes",
+	.cra_driver_name	= "aes-arm",
+	.cra_priority		= 200,
+	.cra_flags		= CRYPTO_ALG_TYPE_CIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct crypto_aes_ctx),
+	.cra_alignmask		= 3,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aes_algs[0].cra_list),
+	.cra_u	= {
+		.cipher	= {
+			.cia_min_keysize	= AES_MIN_KEY_SIZE,
+			.cia_max_keysize	= AES_MAX_KEY_SIZE,
+			.cia_setkey		= crypto_aes_set_key,
+			.cia_encrypt		= aes_encrypt,
+			.cia_decrypt		= aes_decrypt
+		}
+	}
+}, {
+	.cra_name		= "cbc(aes)",
+	.cra_driver_name	= "cbc-aes-arm",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct crypto_aes_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aes_algs[1].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= crypto_aes_set_key,
+			.encrypt	= cbc_encrypt,
+			.decrypt	= cbc_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "ctr(aes)",
+	.cra_driver_name	= "ctr-aes-arm",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct crypto_aes_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aes_algs[2].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= crypto_aes_set_key,
+			.encrypt	= ctr_crypt,
+			.decrypt	= ctr_crypt,
+		},
+	},
+} };
+
+static int __init aes_arm_init(void)
+{
+	int i, err;
+
+	for (i = 0; i < ARRAY_SIZE(aes_algs); i++) {
+		err = crypto_register_alg(&aes_algs[i]);
+		if (err)
+			goto unregister;
+	}
+	return 0;
+
+unregister:
+	while (i--)
+		crypto_unregister_alg(&aes_algs[i]);
+	return err;
+}
+
+static void __exit aes_arm_fini(void)
+{
+	int i;
+
+	for (i = ARRAY_SIZE(aes_algs) - 1; i >= 0; i--)
+		crypto_unregister_alg(&aes_algs[i]);
+}
+
+module_init(aes_arm_init);
+module_exit(aes_arm_fini);
+
+MODULE_DESCRIPTION("Rijndael (AES) Cipher Algorithm, ARM assembler");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("aes");
+MODULE_ALIAS("aes-arm");
+MODULE_ALIAS("cbc(aes)");
+MODULE_ALIAS("ctr(aes)");
@@ -0,0 +1,189 @@
+/*
+ * Cryptographic API.
+ *
+ * CRC32c (Castagnoli) using an ARM assembler "slice by 8" inner loop.
+ *
+ * The generic driver processes the same algorithm through lib/crc32.c;
+ * this one keeps the eight tables' base addresses in registers and,
+ * on ARMv6 and later, extracts each index byte with a single uxtb, so
+ * it is registered at a higher priority.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <crypto/internal/hash.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/kernel.h>
+
+#define CHKSUM_BLOCK_SIZE	1
+#define CHKSUM_DIGEST_SIZE	4
+
+#define CRC32C_POLY_LE		0x82F63B78
+
+struct chksum_ctx {
+	u32 key;
+};
+
+struct chksum_desc_ctx {
+	u32 crc;
+};
+
+static u32 crc32c_arm_table[8][256] __read_mostly;
+
+asmlinkage u32 crc32c_arm_le_8(u32 crc, const u8 *p, unsigned int nblocks,
+			       const u32 (*tab)[256]);
+
+static void __init crc32c_arm_init_table(void)
+{
+	unsigned int i, j;
+	u32 crc;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY_LE : 0);
+		crc32c_arm_table[0][i] = crc;
+	}
+	for (i = 0; i < 256; i++) {
+		crc = crc32c_arm_table[0][i];
+		for (j = 1; j < 8; j++) {
+			crc = crc32c_arm_table[0][crc & 0xff] ^ (crc >> 8);
+			crc32c_arm_table[j][i] = crc;
+		}
+	}
+}
+
+static u32 crc32c_arm_le(u32 crc, const u8 *p, unsigned int len)
+{
+	/* Align for ldm, hand whole 8-byte blocks to the asm, finish bytewise */
+	while (len && ((unsigned long)p & 3)) {
+		crc = crc32c_arm_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+	if (len >= 8) {
+		crc = crc32c_arm_le_8(crc, p, len >> 3, crc32c_arm_table);
+		p += len & ~7;
+		len &= 7;
+	}
+	while (len--)
+		crc = crc32c_arm_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+static int chksum_init(struct shash_desc *desc)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(desc->tfm);
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	ctx->crc = mctx->key;
+
+	return 0;
+}
+
+/*
+ * Setting the seed allows arbitrary accumulators and flexible XOR policy
+ * If your algorithm starts with ~0, then XOR with ~0 before you set
+ * the seed.
+ */
+static int chksum_setkey(struct crypto_shash *tfm, const u8 *key,
+			 unsigned int keylen)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(tfm);
+
+	if (keylen != sizeof(mctx->key)) {
+		crypto_shash_set_flags(tfm, CRYPTO_TFM_RES_BAD_KEY_LEN);
+		return -EINVAL;
+	}
+	mctx->key = le32_to_cpu(*(__le32 *)key);
+	return 0;
+}
+
+static int chksum_update(struct shash_desc *desc, const u8 *data,
+			 unsigned int length)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	ctx->crc = crc32c_arm_le(ctx->crc, data, length);
+	return 0;
+}
+
+static int chksum_final(struct shash_desc *desc, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	*(__le32 *)out = ~cpu_to_le32p(&ctx->crc);
+	return 0;
+}
+
+static int __chksum_finup(u32 *crcp, const u8 *data, unsigned int len, u8 *out)
+{
+	*(__le32 *)out = ~cpu_to_le32(crc32c_arm_le(*crcp, data, len));
+	return 0;
+}
+
+static int chksum_finup(struct shash_desc *desc, const u8 *data,
+			unsigned int len, u8 *out)
+{
+	struct chksum_desc_ctx *ctx = shash_desc_ctx(desc);
+
+	return __chksum_finup(&ctx->crc, data, len, out);
+}
+
+static int chksum_digest(struct shash_desc *desc, const u8 *data,
+			 unsigned int length, u8 *out)
+{
+	struct chksum_ctx *mctx = crypto_shash_ctx(desc->tfm);
+
+	return __chksum_finup(&mctx->key, data, length, out);
+}
+
+static int crc32c_arm_cra_init(struct crypto_tfm *tfm)
+{
+	struct chksum_ctx *mctx = crypto_tfm_ctx(tfm);
+
+	mctx->key = ~0;
+	return 0;
+}
+
+static struct shash_alg alg = {
+	.digestsize		=	CHKSUM_DIGEST_SIZE,
+	.setkey			=	chksum_setkey,
+	.init			=	chksum_init,
+	.update			=	chksum_update,
+	.final			=	chksum_final,
+	.finup			=	chksum_finup,
+	.digest			=	chksum_digest,
+	.descsize		=	sizeof(struct chksum_desc_ctx),
+	.base			=	{
+		.cra_name		=	"crc32c",
+		.cra_driver_name	=	"crc32c-arm",
+		.cra_priority		=	200,
+		.cra_blocksize		=	CHKSUM_BLOCK_SIZE,
+		.cra_ctxsize		=	sizeof(struct chksum_ctx),
+		.cra_module		=	THIS_MODULE,
+		.cra_init		=	crc32c_arm_cra_init,
+	}
+};
+
+static int __init crc32c_arm_mod_init(void)
+{
+	crc32c_arm_init_table();
+	return crypto_register_shash(&alg);
+}
+
+static void __exit crc32c_arm_mod_fini(void)
+{
+	crypto_unregister_shash(&alg);
+}
+
+module_init(crc32c_arm_mod_init);
+module_exit(crc32c_arm_mod_fini);
+
+MODULE_DESCRIPTION("CRC32c (Castagnoli) algorithm, ARM assembler");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("crc32c");
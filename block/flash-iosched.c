@@ -0,0 +1,537 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  Based on the deadline i/o scheduler, Copyright (C) 2002 Jens Axboe.
+ *
+ *  Flash media (raw NAND behind a block translation layer, SD and eMMC
+ *  FTLs) pay for a write with a read-modify-erase of the whole erase
+ *  block it lands in.  This scheduler keeps reads in front, and hands
+ *  writes to the driver one erase block at a time, so that all queued
+ *  writes to a block reach the translation layer together.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+
+/*
+ * See Documentation/block/flash-iosched.txt
+ */
+static const int read_expire = HZ / 4;	/* max time before a read is submitted. */
+static const int write_expire = 5 * HZ;	/* ditto for writes, these limits are SOFT! */
+static const int writes_starved = 4;	/* max times reads can starve a write */
+static const int read_batch = 16;	/* # of sequential reads treated as one */
+static const int write_batch_ebs = 1;	/* # of erase blocks in a write batch */
+
+/* Erase block size if neither the user nor the queue limits give one */
+#define FLASH_DEFAULT_EB_SECTORS	(128 * 1024 >> 9)
+
+struct flash_data {
+	/*
+	 * run time data
+	 */
+
+	/*
+	 * requests are present on both sort_list and fifo_list
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[2];
+
+	/*
+	 * next in sort order. read, write or both are NULL
+	 */
+	struct request *next_rq[2];
+	unsigned int read_batching;	/* number of sequential reads made */
+	unsigned int write_ebs;		/* erase blocks in this write batch */
+	sector_t write_eb;		/* erase block being written */
+	unsigned int starved;		/* times reads have starved writes */
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[2];
+	int read_batch;
+	int write_batch_ebs;
+	int writes_starved;
+	int front_merges;
+	int erase_block_kb;		/* 0: from the queue limits */
+};
+
+static void flash_move_request(struct flash_data *, struct request *);
+
+/*
+ * Erase block size in sectors.  The queue limits are looked up every time,
+ * drivers usually set them after the elevator was initialised.
+ */
+static sector_t flash_eb_sectors(struct flash_data *fd, struct request_queue *q)
+{
+	if (fd->erase_block_kb)
+		return fd->erase_block_kb << 1;
+	if (q->limits.io_opt >= 512)
+		return q->limits.io_opt >> 9;
+	if (q->limits.discard_granularity >= 512)
+		return q->limits.discard_granularity >> 9;
+	return FLASH_DEFAULT_EB_SECTORS;
+}
+
+static sector_t flash_rq_eb(struct flash_data *fd, struct request *rq)
+{
+	sector_t pos = blk_rq_pos(rq);
+
+	sector_div(pos, flash_eb_sectors(fd, rq->q));
+	return pos;
+}
+
+static inline struct rb_root *
+flash_rb_root(struct flash_data *fd, struct request *rq)
+{
+	return &fd->sort_list[rq_data_dir(rq)];
+}
+
+/*
+ * get the request after `rq' in sector-sorted order
+ */
+static inline struct request *
+flash_latter_request(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	if (node)
+		return rb_entry_rq(node);
+
+	return NULL;
+}
+
+static inline struct request *
+flash_former_request(struct request *rq)
+{
+	struct rb_node *node = rb_prev(&rq->rb_node);
+
+	if (node)
+		return rb_entry_rq(node);
+
+	return NULL;
+}
+
+static void
+flash_add_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	struct rb_root *root = flash_rb_root(fd, rq);
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(root, rq)))
+		flash_move_request(fd, __alias);
+}
+
+static inline void
+flash_del_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	const int data_dir = rq_data_dir(rq);
+
+	if (fd->next_rq[data_dir] == rq)
+		fd->next_rq[data_dir] = flash_latter_request(rq);
+
+	elv_rb_del(flash_rb_root(fd, rq), rq);
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void
+flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int data_dir = rq_data_dir(rq);
+
+	flash_add_rq_rb(fd, rq);
+
+	/*
+	 * set expire time and add to fifo list
+	 */
+	rq_set_fifo_time(rq, jiffies + fd->fifo_expire[data_dir]);
+	list_add_tail(&rq->queuelist, &fd->fifo_list[data_dir]);
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	flash_del_rq_rb(fd, rq);
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	/*
+	 * check for front merge
+	 */
+	if (fd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&fd->sort_list[bio_data_dir(bio)], sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(flash_rb_root(fd, req), req);
+		flash_add_rq_rb(fd, req);
+	}
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	flash_remove_request(q, next);
+}
+
+/*
+ * move an entry to dispatch queue
+ */
+static void
+flash_move_request(struct flash_data *fd, struct request *rq)
+{
+	const int data_dir = rq_data_dir(rq);
+
+	fd->next_rq[data_dir] = flash_latter_request(rq);
+
+	/*
+	 * take it off the sort and fifo list, move
+	 * to dispatch queue
+	 */
+	flash_remove_request(rq->q, rq);
+	elv_dispatch_add_tail(rq->q, rq);
+}
+
+/*
+ * flash_check_fifo returns 0 if there are no expired requests on the fifo,
+ * 1 otherwise.
+ */
+static inline int flash_check_fifo(struct flash_data *fd, int ddir)
+{
+	struct request *rq;
+
+	if (list_empty(&fd->fifo_list[ddir]))
+		return 0;
+
+	rq = rq_entry_fifo(fd->fifo_list[ddir].next);
+
+	/*
+	 * rq is expired!
+	 */
+	if (time_after(jiffies, rq_fifo_time(rq)))
+		return 1;
+
+	return 0;
+}
+
+/*
+ * Start a write batch.  The erase block is the one of the oldest write if
+ * that has expired, otherwise the next one up from the previous batch
+ * (wrapping around), and the batch begins at its lowest queued sector.
+ */
+static struct request *flash_start_write_batch(struct flash_data *fd)
+{
+	struct request *rq, *prev;
+
+	if (flash_check_fifo(fd, WRITE))
+		rq = rq_entry_fifo(fd->fifo_list[WRITE].next);
+	else if (fd->next_rq[WRITE])
+		rq = fd->next_rq[WRITE];
+	else
+		rq = rb_entry_rq(rb_first(&fd->sort_list[WRITE]));
+
+	fd->write_eb = flash_rq_eb(fd, rq);
+	while ((prev = flash_former_request(rq)) &&
+	       flash_rq_eb(fd, prev) == fd->write_eb)
+		rq = prev;
+
+	fd->write_ebs = 1;
+	return rq;
+}
+
+/*
+ * Continue the current write batch: the rest of the erase block, then
+ * the following erase blocks until write_batch_ebs are done.  Returns
+ * NULL once the batch is over.
+ */
+static struct request *flash_continue_write_batch(struct flash_data *fd)
+{
+	struct request *rq = fd->next_rq[WRITE];
+	sector_t eb;
+
+	if (!fd->write_ebs || !rq)
+		return NULL;
+
+	eb = flash_rq_eb(fd, rq);
+	if (eb != fd->write_eb) {
+		if (fd->write_ebs >= fd->write_batch_ebs)
+			return NULL;
+		fd->write_ebs++;
+		fd->write_eb = eb;
+	}
+
+	return rq;
+}
+
+/*
+ * flash_dispatch_requests selects the best request according to
+ * read/write expire, batching, erase block, etc
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int reads = !list_empty(&fd->fifo_list[READ]);
+	const int writes = !list_empty(&fd->fifo_list[WRITE]);
+	struct request *rq;
+
+	/*
+	 * A write batch is only cut short by an expired read, the point is
+	 * to hand over an erase block's worth of writes in one go.
+	 */
+	if (!(reads && flash_check_fifo(fd, READ))) {
+		rq = flash_continue_write_batch(fd);
+		if (rq)
+			goto dispatch_request;
+	}
+	fd->write_ebs = 0;
+
+	rq = fd->next_rq[READ];
+	if (rq && fd->read_batching < fd->read_batch)
+		goto dispatch_read;
+
+	/*
+	 * at this point we are not running a batch. select the appropriate
+	 * data direction (read / write)
+	 */
+
+	if (reads) {
+		BUG_ON(RB_EMPTY_ROOT(&fd->sort_list[READ]));
+
+		if (writes && (fd->starved++ >= fd->writes_starved ||
+			       flash_check_fifo(fd, WRITE)))
+			goto dispatch_writes;
+
+		if (flash_check_fifo(fd, READ) || !fd->next_rq[READ])
+			rq = rq_entry_fifo(fd->fifo_list[READ].next);
+		else
+			rq = fd->next_rq[READ];
+
+		fd->read_batching = 0;
+		goto dispatch_read;
+	}
+
+	/*
+	 * there are either no reads or writes have been starved
+	 */
+
+	if (writes) {
+dispatch_writes:
+		BUG_ON(RB_EMPTY_ROOT(&fd->sort_list[WRITE]));
+
+		fd->starved = 0;
+		rq = flash_start_write_batch(fd);
+		goto dispatch_request;
+	}
+
+	return 0;
+
+dispatch_read:
+	fd->read_batching++;
+dispatch_request:
+	flash_move_request(fd, rq);
+
+	return 1;
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	BUG_ON(!list_empty(&fd->fifo_list[READ]));
+	BUG_ON(!list_empty(&fd->fifo_list[WRITE]));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	INIT_LIST_HEAD(&fd->fifo_list[READ]);
+	INIT_LIST_HEAD(&fd->fifo_list[WRITE]);
+	fd->sort_list[READ] = RB_ROOT;
+	fd->sort_list[WRITE] = RB_ROOT;
+	fd->fifo_expire[READ] = read_expire;
+	fd->fifo_expire[WRITE] = write_expire;
+	fd->writes_starved = writes_starved;
+	fd->front_merges = 1;
+	fd->read_batch = read_batch;
+	fd->write_batch_ebs = write_batch_ebs;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_read_expire_show, fd->fifo_expire[READ], 1);
+SHOW_FUNCTION(flash_write_expire_show, fd->fifo_expire[WRITE], 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_front_merges_show, fd->front_merges, 0);
+SHOW_FUNCTION(flash_read_batch_show, fd->read_batch, 0);
+SHOW_FUNCTION(flash_write_batch_ebs_show, fd->write_batch_ebs, 0);
+SHOW_FUNCTION(flash_erase_block_kb_show, fd->erase_block_kb, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_read_expire_store, &fd->fifo_expire[READ], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_write_expire_store, &fd->fifo_expire[WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, INT_MIN, INT_MAX, 0);
+STORE_FUNCTION(flash_front_merges_store, &fd->front_merges, 0, 1, 0);
+STORE_FUNCTION(flash_read_batch_store, &fd->read_batch, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_write_batch_ebs_store, &fd->write_batch_ebs, 1, INT_MAX, 0);
+STORE_FUNCTION(flash_erase_block_kb_store, &fd->erase_block_kb, 0, INT_MAX / 2, 0);
+#undef STORE_FUNCTION
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(read_expire),
+	FD_ATTR(write_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(front_merges),
+	FD_ATTR(read_batch),
+	FD_ATTR(write_batch_ebs),
+	FD_ATTR(erase_block_kb),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Flash erase block aware IO scheduler");
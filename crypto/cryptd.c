@@ -24,6 +24,7 @@
 #include <crypto/crypto_wq.h>
 #include <linux/err.h>
 #include <linux/init.h>
+#include <linux/interrupt.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/module.h>
@@ -33,6 +34,10 @@
 
 #define CRYPTD_MAX_CPU_QLEN 100
 
+static unsigned int cryptd_batch = 8;
+module_param_named(batch, cryptd_batch, uint, 0644);
+MODULE_PARM_DESC(batch, "Maximum number of requests handled per worker run");
+
 struct cryptd_cpu_queue {
 	struct crypto_queue queue;
 	struct work_struct work;
@@ -119,38 +124,45 @@ static int cryptd_enqueue_request(struct cryptd_queue *queue,
 	int cpu, err;
 	struct cryptd_cpu_queue *cpu_queue;
 
-	cpu = get_cpu();
+	local_bh_disable();
+	cpu = smp_processor_id();
 	cpu_queue = this_cpu_ptr(queue->cpu_queue);
 	err = crypto_enqueue_request(&cpu_queue->queue, request);
 	queue_work_on(cpu, kcrypto_wq, &cpu_queue->work);
-	put_cpu();
+	local_bh_enable();
 
 	return err;
 }
 
-/* Called in workqueue context, do one real cryption work (via
- * req->complete) and reschedule itself if there are more work to
- * do. */
+/*
+ * Called in workqueue context.  Do up to cryptd_batch real cryption
+ * works (via req->complete) and reschedule itself if there is more work
+ * to do: a burst of requests, e.g. the packets of one NAPI poll, costs a
+ * single wakeup, while the limit keeps us from hogging the crypto
+ * workqueue.  Requests may be queued from softirq context (IPsec), so
+ * the queue is accessed with bottom halves disabled.
+ */
 static void cryptd_queue_worker(struct work_struct *work)
 {
 	struct cryptd_cpu_queue *cpu_queue;
 	struct crypto_async_request *req, *backlog;
+	unsigned int n;
 
 	cpu_queue = container_of(work, struct cryptd_cpu_queue, work);
-	/* Only handle one request at a time to avoid hogging crypto
-	 * workqueue. preempt_disable/enable is used to prevent
-	 * being preempted by cryptd_enqueue_request() */
-	preempt_disable();
-	backlog = crypto_get_backlog(&cpu_queue->queue);
-	req = crypto_dequeue_request(&cpu_queue->queue);
-	preempt_enable();
-
-	if (!req)
-		return;
 
-	if (backlog)
-		backlog->complete(backlog, -EINPROGRESS);
-	req->complete(req, 0);
+	for (n = 0; n < cryptd_batch; n++) {
+		local_bh_disable();
+		backlog = crypto_get_backlog(&cpu_queue->queue);
+		req = crypto_dequeue_request(&cpu_queue->queue);
+		local_bh_enable();
+
+		if (!req)
+			return;
+
+		if (backlog)
+			backlog->complete(backlog, -EINPROGRESS);
+		req->complete(req, 0);
+	}
 
 	if (cpu_queue->queue.qlen)
 		queue_work(kcrypto_wq, &cpu_queue->work);
@@ -622,22 +634,53 @@ out_put_alg:
 	return err;
 }
 
+static int cryptd_aead_setkey(struct crypto_aead *parent,
+			      const u8 *key, unsigned int keylen)
+{
+	struct cryptd_aead_ctx *ctx = crypto_aead_ctx(parent);
+	struct crypto_aead *child = ctx->child;
+	int err;
+
+	crypto_aead_clear_flags(child, CRYPTO_TFM_REQ_MASK);
+	crypto_aead_set_flags(child, crypto_aead_get_flags(parent) &
+				     CRYPTO_TFM_REQ_MASK);
+	err = crypto_aead_setkey(child, key, keylen);
+	crypto_aead_set_flags(parent, crypto_aead_get_flags(child) &
+				      CRYPTO_TFM_RES_MASK);
+	return err;
+}
+
+static int cryptd_aead_setauthsize(struct crypto_aead *parent,
+				   unsigned int authsize)
+{
+	struct cryptd_aead_ctx *ctx = crypto_aead_ctx(parent);
+
+	return crypto_aead_setauthsize(ctx->child, authsize);
+}
+
+/*
+ * The child works on the same request, so its request context overlays
+ * ours: fetch the caller's completion before handing the request over.
+ */
 static void cryptd_aead_crypt(struct aead_request *req,
 			struct crypto_aead *child,
 			int err,
 			int (*crypt)(struct aead_request *req))
 {
 	struct cryptd_aead_request_ctx *rctx;
+	crypto_completion_t complete;
+
 	rctx = aead_request_ctx(req);
+	complete = rctx->complete;
 
 	if (unlikely(err == -EINPROGRESS))
 		goto out;
 	aead_request_set_tfm(req, child);
 	err = crypt( req );
-	req->base.complete = rctx->complete;
+	req->base.complete = complete;
 out:
 	local_bh_disable();
-	rctx->complete(&req->base, err);
+	complete(&req->base, err);
 	local_bh_enable();
 }
 
@@ -661,6 +704,36 @@ static void cryptd_aead_decrypt(struct crypto_async_request *areq, int err)
 	cryptd_aead_crypt(req, child, err, crypto_aead_crt(child)->decrypt);
 }
 
+static int cryptd_aead_child_givencrypt(struct aead_request *req)
+{
+	return crypto_aead_givencrypt(container_of(req,
+					struct aead_givcrypt_request, areq));
+}
+
+static int cryptd_aead_child_givdecrypt(struct aead_request *req)
+{
+	return crypto_aead_givdecrypt(container_of(req,
+					struct aead_givcrypt_request, areq));
+}
+
+static void cryptd_aead_givencrypt(struct crypto_async_request *areq, int err)
+{
+	struct cryptd_aead_ctx *ctx = crypto_tfm_ctx(areq->tfm);
+	struct aead_request *req;
+
+	req = container_of(areq, struct aead_request, base);
+	cryptd_aead_crypt(req, ctx->child, err, cryptd_aead_child_givencrypt);
+}
+
+static void cryptd_aead_givdecrypt(struct crypto_async_request *areq, int err)
+{
+	struct cryptd_aead_ctx *ctx = crypto_tfm_ctx(areq->tfm);
+	struct aead_request *req;
+
+	req = container_of(areq, struct aead_request, base);
+	cryptd_aead_crypt(req, ctx->child, err, cryptd_aead_child_givdecrypt);
+}
+
 static int cryptd_aead_enqueue(struct aead_request *req,
 				    crypto_completion_t complete)
 {
@@ -683,6 +756,16 @@ static int cryptd_aead_decrypt_enqueue(struct aead_request *req)
 	return cryptd_aead_enqueue(req, cryptd_aead_decrypt );
 }
 
+static int cryptd_aead_givencrypt_enqueue(struct aead_givcrypt_request *req)
+{
+	return cryptd_aead_enqueue(&req->areq, cryptd_aead_givencrypt);
+}
+
+static int cryptd_aead_givdecrypt_enqueue(struct aead_givcrypt_request *req)
+{
+	return cryptd_aead_enqueue(&req->areq, cryptd_aead_givdecrypt);
+}
+
 static int cryptd_aead_init_tfm(struct crypto_tfm *tfm)
 {
 	struct crypto_instance *inst = crypto_tfm_alg_instance(tfm);
@@ -697,7 +780,9 @@ static int cryptd_aead_init_tfm(struct crypto_tfm *tfm)
 
 	crypto_aead_set_flags(cipher, CRYPTO_TFM_REQ_MAY_SLEEP);
 	ctx->child = cipher;
-	tfm->crt_aead.reqsize = sizeof(struct cryptd_aead_request_ctx);
+	tfm->crt_aead.reqsize = max_t(unsigned int,
+				      sizeof(struct cryptd_aead_request_ctx),
+				      crypto_aead_reqsize(cipher));
 	return 0;
 }
 
@@ -739,15 +824,17 @@ static int cryptd_create_aead(struct crypto_template *tmpl,
 	inst->alg.cra_ctxsize = sizeof(struct cryptd_aead_ctx);
 	inst->alg.cra_init = cryptd_aead_init_tfm;
 	inst->alg.cra_exit = cryptd_aead_exit_tfm;
-	inst->alg.cra_aead.setkey      = alg->cra_aead.setkey;
-	inst->alg.cra_aead.setauthsize = alg->cra_aead.setauthsize;
+	inst->alg.cra_aead.setkey      = cryptd_aead_setkey;
+	inst->alg.cra_aead.setauthsize = cryptd_aead_setauthsize;
 	inst->alg.cra_aead.geniv       = alg->cra_aead.geniv;
 	inst->alg.cra_aead.ivsize      = alg->cra_aead.ivsize;
 	inst->alg.cra_aead.maxauthsize = alg->cra_aead.maxauthsize;
 	inst->alg.cra_aead.encrypt     = cryptd_aead_encrypt_enqueue;
 	inst->alg.cra_aead.decrypt     = cryptd_aead_decrypt_enqueue;
-	inst->alg.cra_aead.givencrypt  = alg->cra_aead.givencrypt;
-	inst->alg.cra_aead.givdecrypt  = alg->cra_aead.givdecrypt;
+	if (alg->cra_aead.givencrypt)
+		inst->alg.cra_aead.givencrypt = cryptd_aead_givencrypt_enqueue;
+	if (alg->cra_aead.givdecrypt)
+		inst->alg.cra_aead.givdecrypt = cryptd_aead_givdecrypt_enqueue;
 
 	err = crypto_register_instance(tmpl, inst);
 	if (err) {
@@ -39,7 +39,7 @@
 /*
  * Need slab memory for testing (size in number of pages).
  */
-#define TVMEMSIZE	4
+#define TVMEMSIZE	16
 
 /*
 * Used by test_cipher_speed()
@@ -1079,6 +1079,22 @@ static int do_test(int m)
 				  speed_template_16_32);
 		break;
 
+	case 207:
+		/* baseline for arch-specific "aes", "cbc(aes)" and "ctr(aes)" */
+		test_cipher_speed("ecb(aes-generic)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ecb(aes-generic)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("cbc(aes-generic)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("cbc(aes-generic)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ctr(aes-generic)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ctr(aes-generic)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		break;
+
 	case 300:
 		/* fall through */
 
@@ -1154,6 +1170,14 @@ static int do_test(int m)
 		test_hash_speed("ghash-generic", sec, hash_speed_template_16);
 		if (mode > 300 && mode < 400) break;
 
+	case 319:
+		test_hash_speed("crc32c", sec, checksum_speed_template);
+		if (mode > 300 && mode < 400) break;
+
+	case 320:
+		test_hash_speed("sha256-generic", sec, generic_hash_speed_template);
+		if (mode > 300 && mode < 400) break;
+
 	case 399:
 		break;
 
@@ -1228,6 +1252,10 @@ static int do_test(int m)
 		test_ahash_speed("rmd320", sec, generic_hash_speed_template);
 		if (mode > 400 && mode < 500) break;
 
+	case 418:
+		test_ahash_speed("crc32c", sec, checksum_speed_template);
+		if (mode > 400 && mode < 500) break;
+
 	case 499:
 		break;
 
@@ -112,4 +112,27 @@ static struct hash_speed hash_speed_template_16[] = {
 	{  .blen = 0,	.plen = 0,	.klen = 0, }
 };
 
+/*
+ * Checksum speed tests: one update per buffer from 64 bytes to 64KiB, as
+ * done by filesystem metadata and network paths, plus small updates.
+ */
+static struct hash_speed checksum_speed_template[] = {
+	{ .blen = 64,	.plen = 64, },
+	{ .blen = 128,	.plen = 128, },
+	{ .blen = 256,	.plen = 256, },
+	{ .blen = 512,	.plen = 512, },
+	{ .blen = 1024,	.plen = 1024, },
+	{ .blen = 2048,	.plen = 2048, },
+	{ .blen = 4096,	.plen = 64, },
+	{ .blen = 4096,	.plen = 4096, },
+	{ .blen = 8192,	.plen = 8192, },
+	{ .blen = 16384, .plen = 16384, },
+	{ .blen = 32768, .plen = 32768, },
+	{ .blen = 65536, .plen = 4096, },
+	{ .blen = 65536, .plen = 65536, },
+
+	/* End marker */
+	{  .blen = 0,	.plen = 0, }
+};
+
 #endif	/* _CRYPTO_TCRYPT_H */
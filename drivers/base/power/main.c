@@ -161,15 +161,26 @@ void device_pm_move_last(struct device *dev)
 	list_move_tail(&dev->power.entry, &dpm_list);
 }
 
+/* Callbacks are timed for initcall_debug and for the suspend profiler */
+static inline bool pm_op_timed(void)
+{
+#ifdef CONFIG_SUSPEND_PROFILE
+	return true;
+#else
+	return initcall_debug;
+#endif
+}
+
 static ktime_t initcall_debug_start(struct device *dev)
 {
 	ktime_t calltime = ktime_set(0, 0);
 
-	if (initcall_debug) {
+	if (initcall_debug)
 		pr_info("calling  %s+ @ %i\n",
 				dev_name(dev), task_pid_nr(current));
+
+	if (pm_op_timed())
 		calltime = ktime_get();
-	}
 
 	return calltime;
 }
@@ -179,9 +190,14 @@ static void initcall_debug_report(struct device *dev, ktime_t calltime,
 {
 	ktime_t delta, rettime;
 
+	if (!pm_op_timed())
+		return;
+
+	rettime = ktime_get();
+	delta = ktime_sub(rettime, calltime);
+	suspend_profile_device(dev, delta);
+
 	if (initcall_debug) {
-		rettime = ktime_get();
-		delta = ktime_sub(rettime, calltime);
 		pr_info("call %s+ returned %d after %Ld usecs\n", dev_name(dev),
 			error, (unsigned long long)ktime_to_ns(delta) >> 10);
 	}
@@ -295,12 +311,12 @@ static int pm_noirq_op(struct device *dev,
 	int error = 0;
 	ktime_t calltime = ktime_set(0, 0), delta, rettime;
 
-	if (initcall_debug) {
+	if (initcall_debug)
 		pr_info("calling  %s+ @ %i, parent: %s\n",
 				dev_name(dev), task_pid_nr(current),
 				dev->parent ? dev_name(dev->parent) : "none");
+	if (pm_op_timed())
 		calltime = ktime_get();
-	}
 
 	switch (state.event) {
 #ifdef CONFIG_SUSPEND
@@ -349,9 +365,14 @@ static int pm_noirq_op(struct device *dev,
 		error = -EINVAL;
 	}
 
+	if (!pm_op_timed())
+		return error;
+
+	rettime = ktime_get();
+	delta = ktime_sub(rettime, calltime);
+	suspend_profile_device(dev, delta);
+
 	if (initcall_debug) {
-		rettime = ktime_get();
-		delta = ktime_sub(rettime, calltime);
 		printk("initcall %s_i+ returned %d after %Ld usecs\n",
 			dev_name(dev), error,
 			(unsigned long long)ktime_to_ns(delta) >> 10);
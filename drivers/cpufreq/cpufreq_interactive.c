@@ -19,8 +19,11 @@
 #include <linux/cpu.h>
 #include <linux/cpumask.h>
 #include <linux/cpufreq.h>
+#include <linux/input.h>
+#include <linux/jiffies.h>
 #include <linux/mutex.h>
 #include <linux/sched.h>
+#include <linux/slab.h>
 #include <linux/tick.h>
 #include <linux/time.h>
 #include <linux/timer.h>
@@ -69,11 +72,46 @@ static u64 hispeed_freq;
 #define DEFAULT_GO_HISPEED_LOAD 95
 static unsigned long go_hispeed_load;
 
+/*
+ * Hold times, per frequency step: "time freq:time freq:time ..." gives the
+ * time to use below the first freq, then at and above each freq.
+ */
+struct sample_times {
+	unsigned int *times;
+	int ntimes;
+};
+
+static DEFINE_SPINLOCK(sample_times_lock);
+
 /*
  * The minimum amount of time to spend at a frequency before we can ramp down.
  */
 #define DEFAULT_MIN_SAMPLE_TIME 20 * USEC_PER_MSEC
-static unsigned long min_sample_time;
+static unsigned int default_min_sample_time[] = { DEFAULT_MIN_SAMPLE_TIME };
+static struct sample_times min_sample_time = {
+	.times = default_min_sample_time,
+	.ntimes = ARRAY_SIZE(default_min_sample_time),
+};
+
+/*
+ * The minimum amount of time to spend at a frequency before we can ramp up
+ * further.  Ramping up from the minimum speed is never delayed.
+ */
+#define DEFAULT_UP_SAMPLE_TIME 0
+static unsigned int default_up_sample_time[] = { DEFAULT_UP_SAMPLE_TIME };
+static struct sample_times up_sample_time = {
+	.times = default_up_sample_time,
+	.ntimes = ARRAY_SIZE(default_up_sample_time),
+};
+
+/*
+ * Speed to boost to on input events (0: no boost), and for how long (us).
+ * Load samples do not take the speed below it while the boost lasts.
+ */
+static unsigned long input_boost_freq;
+#define DEFAULT_INPUT_BOOST_TIME 500 * USEC_PER_MSEC
+static unsigned long input_boost_time;
+static u64 input_boost_until;
 
 /*
  * The sample rate of the timer used to increase frequency
@@ -94,6 +132,28 @@ struct cpufreq_governor cpufreq_gov_interactive = {
 	.owner = THIS_MODULE,
 };
 
+/* The hold time of @st that applies at @freq */
+static unsigned int freq_to_sample_time(struct sample_times *st,
+					unsigned int freq)
+{
+	unsigned long flags;
+	unsigned int ret;
+	int i;
+
+	spin_lock_irqsave(&sample_times_lock, flags);
+	for (i = 0; i < st->ntimes - 1 && freq >= st->times[i + 1]; i += 2)
+		;
+	ret = st->times[i];
+	spin_unlock_irqrestore(&sample_times_lock, flags);
+
+	return ret;
+}
+
+static bool input_boosted(void)
+{
+	return input_boost_freq && get_jiffies_64() < input_boost_until;
+}
+
 static void cpufreq_interactive_timer(unsigned long data)
 {
 	unsigned int delta_idle;
@@ -175,6 +235,12 @@ static void cpufreq_interactive_timer(unsigned long data)
 		new_freq = pcpu->policy->cur * cpu_load / 100;
 	}
 
+	if (new_freq < input_boost_freq && input_boosted()) {
+		trace_cpufreq_interactive_boosted(data, cpu_load, new_freq,
+						  input_boost_freq);
+		new_freq = input_boost_freq;
+	}
+
 	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
 					   new_freq, CPUFREQ_RELATION_H,
 					   &index)) {
@@ -192,13 +258,27 @@ static void cpufreq_interactive_timer(unsigned long data)
 		goto rearm_if_notmax;
 	}
 
+	/*
+	 * Do not scale up further unless we have been at this frequency for
+	 * the up sample time.
+	 */
+	if (new_freq > pcpu->target_freq &&
+	    pcpu->target_freq != pcpu->policy->min) {
+		if (cputime64_sub(pcpu->timer_run_time, pcpu->freq_change_time)
+		    < freq_to_sample_time(&up_sample_time, pcpu->target_freq)) {
+			trace_cpufreq_interactive_notyet(data, cpu_load,
+					 pcpu->target_freq, new_freq);
+			goto rearm;
+		}
+	}
+
 	/*
 	 * Do not scale down unless we have been at this frequency for the
 	 * minimum sample time.
 	 */
 	if (new_freq < pcpu->target_freq) {
 		if (cputime64_sub(pcpu->timer_run_time, pcpu->freq_change_time)
-		    < min_sample_time) {
+		    < freq_to_sample_time(&min_sample_time, pcpu->target_freq)) {
 			trace_cpufreq_interactive_notyet(data, cpu_load,
 					 pcpu->target_freq, new_freq);
 			goto rearm;
@@ -448,6 +528,144 @@ static void cpufreq_interactive_freq_down(struct work_struct *work)
 	}
 }
 
+/*
+ * Raise the target speed of every CPU to input_boost_freq.  Called from the
+ * input event handler, in atomic context.
+ */
+static void cpufreq_interactive_input_boost(void)
+{
+	unsigned int cpu, index;
+	unsigned long flags;
+	int kick = 0;
+	struct cpufreq_interactive_cpuinfo *pcpu;
+
+	for_each_online_cpu(cpu) {
+		pcpu = &per_cpu(cpuinfo, cpu);
+		smp_rmb();
+
+		if (!pcpu->governor_enabled)
+			continue;
+
+		if (cpufreq_frequency_table_target(pcpu->policy,
+						   pcpu->freq_table,
+						   input_boost_freq,
+						   CPUFREQ_RELATION_H, &index))
+			continue;
+
+		if (pcpu->target_freq >= pcpu->freq_table[index].frequency)
+			continue;
+
+		pcpu->target_freq = pcpu->freq_table[index].frequency;
+		/*
+		 * The hold times and the load since the last change count
+		 * from the boost, not from the speed it replaced.
+		 */
+		pcpu->freq_change_time_in_idle =
+			get_cpu_idle_time_us(cpu, &pcpu->freq_change_time);
+		spin_lock_irqsave(&up_cpumask_lock, flags);
+		cpumask_set_cpu(cpu, &up_cpumask);
+		spin_unlock_irqrestore(&up_cpumask_lock, flags);
+		kick = 1;
+	}
+
+	if (kick)
+		wake_up_process(up_task);
+}
+
+static void cpufreq_interactive_input_event(struct input_handle *handle,
+					    unsigned int type,
+					    unsigned int code, int value)
+{
+	int boosted;
+
+	if (!input_boost_freq)
+		return;
+
+	/*
+	 * Every event extends the boost, only the first one of a burst
+	 * changes speeds.
+	 */
+	boosted = input_boosted();
+	input_boost_until = get_jiffies_64() +
+		usecs_to_jiffies(input_boost_time);
+	if (boosted)
+		return;
+
+	trace_cpufreq_interactive_boost(input_boost_freq, input_boost_time);
+	cpufreq_interactive_input_boost();
+}
+
+static int cpufreq_interactive_input_connect(struct input_handler *handler,
+					     struct input_dev *dev,
+					     const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "cpufreq_interactive";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return error;
+}
+
+static void cpufreq_interactive_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+/* Touchscreens and keys */
+static const struct input_device_id cpufreq_interactive_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) |
+			    BIT_MASK(ABS_MT_POSITION_Y) },
+	},
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	},
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+	},
+	{ },
+};
+
+static struct input_handler cpufreq_interactive_input_handler = {
+	.event		= cpufreq_interactive_input_event,
+	.connect	= cpufreq_interactive_input_connect,
+	.disconnect	= cpufreq_interactive_input_disconnect,
+	.name		= "cpufreq_interactive",
+	.id_table	= cpufreq_interactive_ids,
+};
+
 static ssize_t show_hispeed_freq(struct kobject *kobj,
 				 struct attribute *attr, char *buf)
 {
@@ -494,23 +712,85 @@ static ssize_t store_go_hispeed_load(struct kobject *kobj,
 static struct global_attr go_hispeed_load_attr = __ATTR(go_hispeed_load, 0644,
 		show_go_hispeed_load, store_go_hispeed_load);
 
+static ssize_t show_sample_times(struct sample_times *st, char *buf)
+{
+	unsigned long flags;
+	ssize_t ret = 0;
+	int i;
+
+	spin_lock_irqsave(&sample_times_lock, flags);
+	for (i = 0; i < st->ntimes; i++)
+		ret += sprintf(buf + ret, "%u%s", st->times[i],
+			       i & 1 ? ":" : " ");
+	spin_unlock_irqrestore(&sample_times_lock, flags);
+	buf[ret - 1] = '\n';
+
+	return ret;
+}
+
+/*
+ * Parse "time freq:time freq:time ...", frequencies in increasing order,
+ * into @st.  A single time applies at all frequencies.
+ */
+static ssize_t store_sample_times(struct sample_times *st, const char *buf,
+				  size_t count)
+{
+	const char *cp = buf;
+	unsigned int *times, *old;
+	unsigned long flags;
+	int ntimes = 1;
+	int i;
+
+	while ((cp = strpbrk(cp + 1, " :")))
+		ntimes++;
+	if (!(ntimes & 1))
+		return -EINVAL;
+
+	times = kmalloc(ntimes * sizeof(*times), GFP_KERNEL);
+	if (!times)
+		return -ENOMEM;
+
+	cp = buf;
+	for (i = 0; i < ntimes; i++) {
+		if (sscanf(cp, "%u", &times[i]) != 1)
+			goto err;
+		/* frequencies are at odd indexes */
+		if ((i & 1) && i > 1 && times[i] <= times[i - 2])
+			goto err;
+		cp = strpbrk(cp, " :");
+		if (!cp)
+			break;
+		cp++;
+	}
+	if (i != ntimes - 1)
+		goto err;
+
+	spin_lock_irqsave(&sample_times_lock, flags);
+	old = st->times;
+	st->times = times;
+	st->ntimes = ntimes;
+	spin_unlock_irqrestore(&sample_times_lock, flags);
+
+	if (old != default_min_sample_time && old != default_up_sample_time)
+		kfree(old);
+
+	return count;
+
+err:
+	kfree(times);
+	return -EINVAL;
+}
+
 static ssize_t show_min_sample_time(struct kobject *kobj,
 				struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", min_sample_time);
+	return show_sample_times(&min_sample_time, buf);
 }
 
 static ssize_t store_min_sample_time(struct kobject *kobj,
 			struct attribute *attr, const char *buf, size_t count)
 {
-	int ret;
-	unsigned long val;
-
-	ret = strict_strtoul(buf, 0, &val);
-	if (ret < 0)
-		return ret;
-	min_sample_time = val;
-	return count;
+	return store_sample_times(&min_sample_time, buf, count);
 }
 
 static struct global_attr min_sample_time_attr = __ATTR(min_sample_time, 0644,
@@ -538,11 +818,73 @@ static ssize_t store_timer_rate(struct kobject *kobj,
 static struct global_attr timer_rate_attr = __ATTR(timer_rate, 0644,
 		show_timer_rate, store_timer_rate);
 
+static ssize_t show_up_sample_time(struct kobject *kobj,
+				struct attribute *attr, char *buf)
+{
+	return show_sample_times(&up_sample_time, buf);
+}
+
+static ssize_t store_up_sample_time(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	return store_sample_times(&up_sample_time, buf, count);
+}
+
+static struct global_attr up_sample_time_attr = __ATTR(up_sample_time, 0644,
+		show_up_sample_time, store_up_sample_time);
+
+static ssize_t show_input_boost_freq(struct kobject *kobj,
+				struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", input_boost_freq);
+}
+
+static ssize_t store_input_boost_freq(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	input_boost_freq = val;
+	return count;
+}
+
+static struct global_attr input_boost_freq_attr = __ATTR(input_boost_freq,
+		0644, show_input_boost_freq, store_input_boost_freq);
+
+static ssize_t show_input_boost_time(struct kobject *kobj,
+				struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", input_boost_time);
+}
+
+static ssize_t store_input_boost_time(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	input_boost_time = val;
+	return count;
+}
+
+static struct global_attr input_boost_time_attr = __ATTR(input_boost_time,
+		0644, show_input_boost_time, store_input_boost_time);
+
 static struct attribute *interactive_attributes[] = {
 	&hispeed_freq_attr.attr,
 	&go_hispeed_load_attr.attr,
 	&min_sample_time_attr.attr,
 	&timer_rate_attr.attr,
+	&up_sample_time_attr.attr,
+	&input_boost_freq_attr.attr,
+	&input_boost_time_attr.attr,
 	NULL,
 };
 
@@ -660,8 +1002,8 @@ static int __init cpufreq_interactive_init(void)
 	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
 
 	go_hispeed_load = DEFAULT_GO_HISPEED_LOAD;
-	min_sample_time = DEFAULT_MIN_SAMPLE_TIME;
 	timer_rate = DEFAULT_TIMER_RATE;
+	input_boost_time = DEFAULT_INPUT_BOOST_TIME;
 
 	/* Initalize per-cpu timers */
 	for_each_possible_cpu(i) {
@@ -693,10 +1035,15 @@ static int __init cpufreq_interactive_init(void)
 	spin_lock_init(&down_cpumask_lock);
 	mutex_init(&set_speed_lock);
 
+	if (input_register_handler(&cpufreq_interactive_input_handler))
+		goto err_freewq;
+
 	idle_notifier_register(&cpufreq_interactive_idle_nb);
 
 	return cpufreq_register_governor(&cpufreq_gov_interactive);
 
+err_freewq:
+	destroy_workqueue(down_wq);
 err_freeuptask:
 	put_task_struct(up_task);
 	return -ENOMEM;
@@ -711,9 +1058,15 @@ module_init(cpufreq_interactive_init);
 static void __exit cpufreq_interactive_exit(void)
 {
 	cpufreq_unregister_governor(&cpufreq_gov_interactive);
+	input_unregister_handler(&cpufreq_interactive_input_handler);
 	kthread_stop(up_task);
 	put_task_struct(up_task);
 	destroy_workqueue(down_wq);
+
+	if (min_sample_time.times != default_min_sample_time)
+		kfree(min_sample_time.times);
+	if (up_sample_time.times != default_up_sample_time)
+		kfree(up_sample_time.times);
 }
 
 module_exit(cpufreq_interactive_exit);
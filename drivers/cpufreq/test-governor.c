@@ -0,0 +1,246 @@
+/*
+ * cpufreq/cpuidle governor replay benchmark.
+ *
+ * Replays a load trace on one CPU: the "trace" parameter lists busy and
+ * idle periods in us, alternately, and is played "loops" times by a kernel
+ * thread bound to "cpu", which spins through the busy periods and sleeps
+ * on an hrtimer through the idle ones.  A busy period is an amount of
+ * work, given as the time it takes at the policy's maximum frequency:
+ * the thread spins until the time spent at each frequency, scaled by
+ * that frequency over the maximum, adds up to it.  So a governor that
+ * keeps the CPU slow stretches the busy periods, as it would for real
+ * CPU-bound work.  It then reports how long the CPU spent at each
+ * frequency, how much longer than at the maximum the busy periods took,
+ * and how late the thread woke up from its idle periods, i.e. what the
+ * cpufreq governor chose and the exit latency of the idle states the
+ * cpuidle governor picked.
+ *
+ * With the virtual cpufreq and cpuidle drivers it runs anywhere, so
+ * governor changes can be compared on a build machine or emulator:
+ *
+ *	modprobe virtual-cpufreq; modprobe virtual-cpuidle
+ *	echo interactive > /sys/devices/system/cpu/cpu0/cpufreq/scaling_governor
+ *	insmod test-governor.ko trace=2000,30000,500,8000 loops=200
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/completion.h>
+#include <linux/cpufreq.h>
+#include <linux/cpumask.h>
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+
+#define REPLAY_MAX_PERIODS	128
+#define REPLAY_MAX_FREQS	32
+
+static unsigned int trace[REPLAY_MAX_PERIODS] = { 2000, 30000, 500, 8000 };
+static unsigned int nr_periods = 4;
+module_param_array(trace, uint, &nr_periods, 0);
+MODULE_PARM_DESC(trace, "Busy (in us at the maximum frequency) and idle periods in us, alternately");
+
+static unsigned int loops = 100;
+module_param(loops, uint, 0);
+MODULE_PARM_DESC(loops, "Number of times to replay the trace");
+
+static unsigned int cpu;
+module_param(cpu, uint, 0);
+MODULE_PARM_DESC(cpu, "CPU to replay the trace on");
+
+struct replay_freq {
+	unsigned int	freq;
+	u64		us;
+};
+
+static DEFINE_SPINLOCK(replay_lock);
+static struct replay_freq residency[REPLAY_MAX_FREQS];
+static unsigned int nr_freqs, transitions;
+static unsigned int cur_freq, max_freq;
+static ktime_t cur_since;
+
+static u64 busy_work_us, busy_us;
+static u64 wakeups, wake_total_us, wake_max_us;
+static DECLARE_COMPLETION(replay_done);
+
+/* Account the time since the last change to the current frequency */
+static void replay_account(ktime_t now)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_freqs; i++)
+		if (residency[i].freq == cur_freq)
+			break;
+	if (i == nr_freqs) {
+		if (nr_freqs == REPLAY_MAX_FREQS)
+			return;
+		residency[nr_freqs].freq = cur_freq;
+		residency[nr_freqs++].us = 0;
+	}
+	residency[i].us += ktime_to_us(ktime_sub(now, cur_since));
+	cur_since = now;
+}
+
+static int replay_transition(struct notifier_block *nb, unsigned long val,
+			     void *data)
+{
+	struct cpufreq_freqs *freq = data;
+	unsigned long flags;
+
+	if (val != CPUFREQ_POSTCHANGE || freq->cpu != cpu)
+		return 0;
+
+	spin_lock_irqsave(&replay_lock, flags);
+	replay_account(ktime_get());
+	cur_freq = freq->new;
+	transitions++;
+	spin_unlock_irqrestore(&replay_lock, flags);
+	return 0;
+}
+
+static struct notifier_block replay_nb = {
+	.notifier_call = replay_transition,
+};
+
+/*
+ * Spin until @us of work at max_freq is done.  Without cpufreq the
+ * work is done at wall-clock speed.
+ */
+static void replay_busy(unsigned int us)
+{
+	s64 work = (s64)us * NSEC_PER_USEC;
+	ktime_t start, last, now;
+	unsigned int freq;
+	u64 delta;
+
+	start = last = ktime_get();
+	while (work > 0) {
+		cpu_relax();
+		now = ktime_get();
+		delta = ktime_to_ns(ktime_sub(now, last));
+		last = now;
+
+		freq = ACCESS_ONCE(cur_freq);
+		if (max_freq && freq && freq < max_freq)
+			delta = div_u64(delta * freq, max_freq);
+		work -= delta;
+	}
+
+	busy_work_us += us;
+	busy_us += ktime_to_us(ktime_sub(last, start));
+}
+
+static void replay_idle(unsigned int us)
+{
+	ktime_t expires = ktime_add_us(ktime_get(), us);
+	u64 late;
+
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+
+	late = max_t(s64, ktime_to_us(ktime_sub(ktime_get(), expires)), 0);
+	wakeups++;
+	wake_total_us += late;
+	wake_max_us = max(wake_max_us, late);
+}
+
+static int replay_thread(void *data)
+{
+	unsigned int loop, i;
+
+	for (loop = 0; loop < loops; loop++) {
+		for (i = 0; i < nr_periods; i++) {
+			if (i & 1)
+				replay_idle(trace[i]);
+			else
+				replay_busy(trace[i]);
+		}
+		cond_resched();
+	}
+
+	complete(&replay_done);
+	return 0;
+}
+
+static int __init test_governor_init(void)
+{
+	struct cpufreq_policy *policy;
+	struct task_struct *task;
+	char governor[CPUFREQ_NAME_LEN] = "none";
+	unsigned long flags;
+	ktime_t start;
+	u64 total_us;
+	unsigned int i;
+	int err;
+
+	if (!nr_periods || !loops || cpu >= nr_cpu_ids || !cpu_online(cpu))
+		return -EINVAL;
+
+	policy = cpufreq_cpu_get(cpu);
+	if (policy) {
+		if (policy->governor)
+			strlcpy(governor, policy->governor->name,
+				sizeof(governor));
+		max_freq = policy->max;
+		cpufreq_cpu_put(policy);
+	}
+
+	task = kthread_create(replay_thread, NULL, "governor_replay");
+	if (IS_ERR(task))
+		return PTR_ERR(task);
+	kthread_bind(task, cpu);
+
+	err = cpufreq_register_notifier(&replay_nb,
+					CPUFREQ_TRANSITION_NOTIFIER);
+	if (err) {
+		kthread_stop(task);
+		return err;
+	}
+
+	start = ktime_get();
+	spin_lock_irqsave(&replay_lock, flags);
+	cur_freq = cpufreq_quick_get(cpu);
+	cur_since = start;
+	spin_unlock_irqrestore(&replay_lock, flags);
+
+	wake_up_process(task);
+	wait_for_completion(&replay_done);
+
+	cpufreq_unregister_notifier(&replay_nb, CPUFREQ_TRANSITION_NOTIFIER);
+	spin_lock_irqsave(&replay_lock, flags);
+	replay_account(ktime_get());
+	spin_unlock_irqrestore(&replay_lock, flags);
+	total_us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+	pr_info("governor_replay: cpu%u governor %s, %u loops of %u periods "
+		"in %llu us, %u frequency changes\n", cpu, governor, loops,
+		nr_periods, total_us, transitions);
+	pr_info("governor_replay: %llu us of busy work at %u kHz took %llu us\n",
+		busy_work_us, max_freq, busy_us);
+	pr_info("governor_replay: %llu wakeups, %llu us late on average, "
+		"%llu us at most\n", wakeups,
+		wakeups ? div64_u64(wake_total_us, wakeups) : 0, wake_max_us);
+	for (i = 0; i < nr_freqs; i++)
+		pr_info("governor_replay: %8u kHz %10llu us %3llu%%\n",
+			residency[i].freq, residency[i].us, total_us ?
+			div64_u64(residency[i].us * 100, total_us) : 0);
+
+	/*
+	 * The replay thread is gone and the notifier unregistered.  Fail the
+	 * load so that the next governor can be replayed straight away.
+	 */
+	return -EAGAIN;
+}
+module_init(test_governor_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("cpufreq/cpuidle governor replay benchmark");
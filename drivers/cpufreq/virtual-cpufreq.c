@@ -0,0 +1,162 @@
+/*
+ * Virtual CPUfreq driver
+ *
+ * Pretends every CPU can run at the frequencies given in the "freqs"
+ * parameter, and takes "latency" us to switch between them, without
+ * touching any clock.  This lets cpufreq governors be exercised and
+ * compared on any machine, emulators included, through the usual cpufreq
+ * sysfs, statistics and tracepoints.
+ *
+ *	modprobe virtual-cpufreq freqs=100000,400000,800000 latency=200
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/cpufreq.h>
+#include <linux/delay.h>
+#include <linux/percpu.h>
+
+#define VIRTUAL_CPUFREQ_MAX_FREQS	16
+
+/* Defaults to the S3C6410 operating points */
+static unsigned int freqs[VIRTUAL_CPUFREQ_MAX_FREQS] = {
+	66000, 100000, 133000, 200000, 222000, 266000,
+	333000, 400000, 532000, 667000, 800000,
+};
+static unsigned int nr_freqs = 11;
+module_param_array(freqs, uint, &nr_freqs, 0444);
+MODULE_PARM_DESC(freqs, "Frequencies in kHz, in increasing order");
+
+static unsigned int latency = 100;
+module_param(latency, uint, 0644);
+MODULE_PARM_DESC(latency, "Transition latency in us");
+
+static struct cpufreq_frequency_table
+		virtual_freq_table[VIRTUAL_CPUFREQ_MAX_FREQS + 1];
+
+static DEFINE_PER_CPU(unsigned int, virtual_cur_freq);
+
+static int virtual_cpufreq_verify_speed(struct cpufreq_policy *policy)
+{
+	return cpufreq_frequency_table_verify(policy, virtual_freq_table);
+}
+
+static unsigned int virtual_cpufreq_get_speed(unsigned int cpu)
+{
+	return per_cpu(virtual_cur_freq, cpu);
+}
+
+static int virtual_cpufreq_set_target(struct cpufreq_policy *policy,
+				      unsigned int target_freq,
+				      unsigned int relation)
+{
+	int ret;
+	unsigned int i;
+	struct cpufreq_freqs freqs;
+
+	ret = cpufreq_frequency_table_target(policy, virtual_freq_table,
+					     target_freq, relation, &i);
+	if (ret != 0)
+		return ret;
+
+	freqs.cpu = policy->cpu;
+	freqs.old = per_cpu(virtual_cur_freq, policy->cpu);
+	freqs.new = virtual_freq_table[i].frequency;
+	freqs.flags = 0;
+
+	if (freqs.old == freqs.new)
+		return 0;
+
+	cpufreq_notify_transition(&freqs, CPUFREQ_PRECHANGE);
+
+	/* Stand-in for the PLL relock and regulator ramp */
+	if (latency)
+		usleep_range(latency, latency + latency / 8);
+	per_cpu(virtual_cur_freq, policy->cpu) = freqs.new;
+
+	cpufreq_notify_transition(&freqs, CPUFREQ_POSTCHANGE);
+
+	return 0;
+}
+
+static int virtual_cpufreq_driver_init(struct cpufreq_policy *policy)
+{
+	int ret;
+
+	/* Start at the highest speed, like most boot loaders leave it */
+	per_cpu(virtual_cur_freq, policy->cpu) = freqs[nr_freqs - 1];
+	policy->cur = freqs[nr_freqs - 1];
+	policy->cpuinfo.transition_latency = latency * 1000;
+
+	cpufreq_frequency_table_get_attr(virtual_freq_table, policy->cpu);
+
+	ret = cpufreq_frequency_table_cpuinfo(policy, virtual_freq_table);
+	if (ret != 0) {
+		pr_err("cpufreq: Failed to configure frequency table: %d\n",
+		       ret);
+		cpufreq_frequency_table_put_attr(policy->cpu);
+	}
+
+	return ret;
+}
+
+static int virtual_cpufreq_driver_exit(struct cpufreq_policy *policy)
+{
+	cpufreq_frequency_table_put_attr(policy->cpu);
+	return 0;
+}
+
+static struct freq_attr *virtual_cpufreq_attr[] = {
+	&cpufreq_freq_attr_scaling_available_freqs,
+	NULL,
+};
+
+static struct cpufreq_driver virtual_cpufreq_driver = {
+	.owner		= THIS_MODULE,
+	.flags		= 0,
+	.verify		= virtual_cpufreq_verify_speed,
+	.target		= virtual_cpufreq_set_target,
+	.get		= virtual_cpufreq_get_speed,
+	.init		= virtual_cpufreq_driver_init,
+	.exit		= virtual_cpufreq_driver_exit,
+	.attr		= virtual_cpufreq_attr,
+	.name		= "virtual",
+};
+
+static int __init virtual_cpufreq_init(void)
+{
+	unsigned int i;
+
+	if (!nr_freqs)
+		return -EINVAL;
+
+	for (i = 0; i < nr_freqs; i++) {
+		if (!freqs[i] || (i && freqs[i] <= freqs[i - 1])) {
+			pr_err("cpufreq: virtual frequencies must increase\n");
+			return -EINVAL;
+		}
+		virtual_freq_table[i].index = i;
+		virtual_freq_table[i].frequency = freqs[i];
+	}
+	virtual_freq_table[i].index = i;
+	virtual_freq_table[i].frequency = CPUFREQ_TABLE_END;
+
+	return cpufreq_register_driver(&virtual_cpufreq_driver);
+}
+module_init(virtual_cpufreq_init);
+
+static void __exit virtual_cpufreq_exit(void)
+{
+	cpufreq_unregister_driver(&virtual_cpufreq_driver);
+}
+module_exit(virtual_cpufreq_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Virtual CPUfreq driver for governor testing");
@@ -0,0 +1,138 @@
+/*
+ * drivers/cpuidle/virtual-cpuidle.c
+ *
+ * Virtual CPU idle driver
+ *
+ * Offers the cpuidle governors the idle states described by the "latency"
+ * and "residency" parameters, on every online CPU and without any platform
+ * support, so that the ladder and menu governors can be exercised on any
+ * machine, emulators included:
+ *
+ *	modprobe virtual-cpuidle latency=1,100,2000 residency=1,500,10000
+ *
+ * All states wait by polling for need_resched() and then spin for the
+ * exit latency of the state with interrupts disabled, so that the task
+ * woken up sees the latency a real state would have added.
+ *
+ * This file is licensed under the terms of the GNU General Public
+ * License version 2.  This program is licensed "as is" without any
+ * warranty of any kind, whether express or implied.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/cpuidle.h>
+#include <linux/cpu.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+
+static unsigned int latency[CPUIDLE_STATE_MAX] = { 1, 100, 2000 };
+static unsigned int nr_states = 3;
+module_param_array(latency, uint, &nr_states, 0444);
+MODULE_PARM_DESC(latency, "Exit latency of each state in us");
+
+static unsigned int residency[CPUIDLE_STATE_MAX] = { 1, 500, 10000 };
+static unsigned int nr_residencies = 3;
+module_param_array(residency, uint, &nr_residencies, 0444);
+MODULE_PARM_DESC(residency, "Target residency of each state in us");
+
+static struct cpuidle_driver virtual_idle_driver = {
+	.name =         "virtual_idle",
+	.owner =        THIS_MODULE,
+};
+
+static DEFINE_PER_CPU(struct cpuidle_device, virtual_cpuidle_device);
+
+static int virtual_enter_idle(struct cpuidle_device *dev,
+			      struct cpuidle_state *state)
+{
+	unsigned int exit_latency = state->exit_latency;
+	ktime_t before, after;
+
+	before = ktime_get();
+	local_irq_enable();
+	while (!need_resched())
+		cpu_relax();
+
+	local_irq_disable();
+	udelay(exit_latency);
+	after = ktime_get();
+	local_irq_enable();
+
+	return ktime_to_us(ktime_sub(after, before));
+}
+
+static void virtual_exit_cpuidle(void)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct cpuidle_device *device =
+			&per_cpu(virtual_cpuidle_device, cpu);
+
+		if (device->registered)
+			cpuidle_unregister_device(device);
+	}
+	cpuidle_unregister_driver(&virtual_idle_driver);
+}
+
+static int __init virtual_init_cpuidle(void)
+{
+	struct cpuidle_device *device;
+	unsigned int cpu, i;
+	int ret;
+
+	if (!nr_states || nr_residencies != nr_states) {
+		pr_err("virtual_cpuidle: need one residency per latency\n");
+		return -EINVAL;
+	}
+
+	ret = cpuidle_register_driver(&virtual_idle_driver);
+	if (ret)
+		return ret;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		device = &per_cpu(virtual_cpuidle_device, cpu);
+		device->cpu = cpu;
+		device->state_count = nr_states;
+
+		for (i = 0; i < nr_states; i++) {
+			struct cpuidle_state *state = &device->states[i];
+
+			state->enter = virtual_enter_idle;
+			state->exit_latency = latency[i];
+			state->target_residency = residency[i];
+			state->flags = CPUIDLE_FLAG_TIME_VALID;
+			snprintf(state->name, CPUIDLE_NAME_LEN, "V%u", i);
+			snprintf(state->desc, CPUIDLE_DESC_LEN,
+				 "Virtual, %u us exit latency", latency[i]);
+		}
+		device->safe_state = &device->states[0];
+
+		ret = cpuidle_register_device(device);
+		if (ret) {
+			pr_err("virtual_cpuidle: Failed registering cpu%u\n",
+			       cpu);
+			break;
+		}
+	}
+	put_online_cpus();
+
+	if (ret)
+		virtual_exit_cpuidle();
+	return ret;
+}
+module_init(virtual_init_cpuidle);
+
+static void __exit virtual_cleanup_cpuidle(void)
+{
+	virtual_exit_cpuidle();
+}
+module_exit(virtual_cleanup_cpuidle);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Virtual CPU idle driver for governor testing");
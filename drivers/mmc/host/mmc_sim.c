@@ -0,0 +1,1170 @@
+/*
+ * Software MMC/SD host emulator
+ *
+ * Emulates a host controller with a single SD (SDHC) or eMMC 4.41 card
+ * in the slot, backed by RAM or by an image file.  It implements the part
+ * of the command set used by the MMC core and the block driver, so the
+ * whole stack above the host driver (queue thread, request pipelining,
+ * partition switching, erase/trim, error recovery) can be exercised and
+ * measured without hardware.
+ *
+ * Every request is executed from a workqueue.  The time a real card would
+ * need is approximated by a per-command access latency plus the time to
+ * move the data, which is bounded by the card throughput parameters and,
+ * unless model_bus=0, by the bus clock and width programmed by the core.
+ * Command timeouts and data CRC errors can be injected into every Nth
+ * data request.
+ *
+ * A host has to prepare the data of a request (map it for DMA, clean or
+ * invalidate the cache) before starting it.  The cost of this is set
+ * with map_ns_per_kb.  With async_prep=1 the emulator implements pre_req
+ * and post_req, so the MMC core can prepare a request while the previous
+ * one is still on the bus; with async_prep=0 every request is prepared
+ * when it is started, as by hosts without these hooks.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/platform_device.h>
+#include <linux/workqueue.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/delay.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/scatterlist.h>
+#include <linux/mmc/host.h>
+#include <linux/mmc/mmc.h>
+#include <linux/mmc/sd.h>
+
+#include <asm/uaccess.h>
+
+#define DRIVER_NAME	"mmc_sim"
+
+static char *card = "mmc";
+module_param(card, charp, 0444);
+MODULE_PARM_DESC(card, "Emulated card type: \"mmc\" (eMMC) or \"sd\" (SDHC)");
+
+static char *image;
+module_param(image, charp, 0444);
+MODULE_PARM_DESC(image, "Back the card by this file instead of RAM");
+
+static unsigned int size_mb = 64;
+module_param(size_mb, uint, 0444);
+MODULE_PARM_DESC(size_mb, "User area size in MiB when backed by RAM");
+
+static unsigned int boot_kb;
+module_param(boot_kb, uint, 0444);
+MODULE_PARM_DESC(boot_kb, "Size of each eMMC boot partition in KiB (multiple of 128)");
+
+static unsigned int bus_width = 8;
+module_param(bus_width, uint, 0444);
+MODULE_PARM_DESC(bus_width, "Host bus width: 1, 4 or 8");
+
+static unsigned int f_max = 52000000;
+module_param(f_max, uint, 0444);
+MODULE_PARM_DESC(f_max, "Maximum bus clock in Hz");
+
+static bool highspeed = 1;
+module_param(highspeed, bool, 0444);
+MODULE_PARM_DESC(highspeed, "Advertise high-speed timing on host and card");
+
+static bool cmd23 = 1;
+module_param(cmd23, bool, 0444);
+MODULE_PARM_DESC(cmd23, "Advertise MMC_CAP_CMD23 (SET_BLOCK_COUNT)");
+
+static unsigned int max_segs = 128;
+module_param(max_segs, uint, 0444);
+MODULE_PARM_DESC(max_segs, "Maximum number of segments per request");
+
+static unsigned int max_blk_count = 1024;
+module_param(max_blk_count, uint, 0444);
+MODULE_PARM_DESC(max_blk_count, "Maximum number of blocks per request");
+
+static bool model_bus = 1;
+module_param(model_bus, bool, 0644);
+MODULE_PARM_DESC(model_bus, "Limit transfers to the bus clock and width");
+
+static unsigned int read_latency_us;
+module_param(read_latency_us, uint, 0644);
+MODULE_PARM_DESC(read_latency_us, "Access time added to every read command");
+
+static unsigned int write_latency_us;
+module_param(write_latency_us, uint, 0644);
+MODULE_PARM_DESC(write_latency_us, "Busy time added to every write command");
+
+static unsigned int erase_latency_us;
+module_param(erase_latency_us, uint, 0644);
+MODULE_PARM_DESC(erase_latency_us, "Busy time added to every erase command");
+
+static unsigned int read_kbps;
+module_param(read_kbps, uint, 0644);
+MODULE_PARM_DESC(read_kbps, "Card read throughput in KiB/s (0 = unlimited)");
+
+static unsigned int write_kbps;
+module_param(write_kbps, uint, 0644);
+MODULE_PARM_DESC(write_kbps, "Card write throughput in KiB/s (0 = unlimited)");
+
+static bool async_prep = 1;
+module_param(async_prep, bool, 0444);
+MODULE_PARM_DESC(async_prep, "Implement pre_req/post_req to prepare requests ahead of time");
+
+static unsigned int map_ns_per_kb;
+module_param(map_ns_per_kb, uint, 0644);
+MODULE_PARM_DESC(map_ns_per_kb, "Host time to prepare each KiB of request data for DMA");
+
+static unsigned int fail_cmd_timeout;
+module_param(fail_cmd_timeout, uint, 0644);
+MODULE_PARM_DESC(fail_cmd_timeout, "Time out the command of every Nth data request (0 = off)");
+
+static unsigned int fail_data_crc;
+module_param(fail_data_crc, uint, 0644);
+MODULE_PARM_DESC(fail_data_crc, "Fail every Nth data request with a CRC error halfway through (0 = off)");
+
+#define SIM_OCR		0x00ff8000	/* 2.7 - 3.6V */
+#define SIM_SD_RCA	0xb368
+#define SIM_SIZE_UNIT	(512 * 1024)	/* SD C_SIZE granularity */
+
+/* SD CCC: basic, block read/write, erase, lock, app specific, switch */
+#define SIM_SD_CCC	0x5b5
+/* MMC CCC: basic, block read/write, erase, write protect, lock */
+#define SIM_MMC_CCC	0x0f5
+
+struct mmc_sim_stats {
+	u64			cmds;
+	u64			reads;
+	u64			read_blocks;
+	u64			writes;
+	u64			write_blocks;
+	u64			erases;
+	u64			erase_blocks;
+	u64			cmd_timeouts;
+	u64			data_crc_errors;
+	u64			busy_us;
+	u64			map_us;
+	u64			premapped;
+};
+
+struct mmc_sim_host {
+	struct mmc_host		*mmc;
+	struct mmc_request	*mrq;
+	struct workqueue_struct	*workqueue;
+	struct work_struct	work;
+
+	/* Backing store: user area, then boot0 and boot1 */
+	void			*ram;
+	struct file		*filp;
+	u64			user_size;
+	u64			boot_size;
+
+	/* Card state */
+	bool			is_sd;
+	unsigned int		state;
+	u16			rca;
+	bool			app_cmd;
+	u32			status_clr;	/* clear-on-read status bits */
+	u32			erase_start;
+	u32			erase_end;
+	u32			wr_blocks;	/* for ACMD22 */
+	u8			sd_function;
+	u32			cid[4];
+	u32			csd[4];
+	u8			ext_csd[512];
+
+	/* Bus setup from set_ios */
+	unsigned int		clock;
+	unsigned char		bus_width;
+
+	unsigned int		data_reqs;
+	struct mmc_sim_stats	stats;
+};
+
+/*
+ * Inverse of UNSTUFF_BITS: resp[0] holds bits 127:96 of a 128-bit
+ * register and resp[3] bits 31:0.
+ */
+static void mmc_sim_stuff(u32 *resp, unsigned int start, unsigned int size,
+			  u32 val)
+{
+	const int off = 3 - start / 32;
+	const int shft = start & 31;
+
+	if (size < 32)
+		val &= (1U << size) - 1;
+	resp[off] |= val << shft;
+	if (size + shft > 32)
+		resp[off - 1] |= val >> (32 - shft);
+}
+
+static void mmc_sim_build_sd_regs(struct mmc_sim_host *sim)
+{
+	u32 *cid = sim->cid, *csd = sim->csd;
+
+	mmc_sim_stuff(cid, 120, 8, 0x00);		/* MID */
+	mmc_sim_stuff(cid, 104, 16, ('S' << 8) | 'M');	/* OID */
+	mmc_sim_stuff(cid, 96, 8, 'S');			/* PNM */
+	mmc_sim_stuff(cid, 88, 8, 'D');
+	mmc_sim_stuff(cid, 80, 8, 'S');
+	mmc_sim_stuff(cid, 72, 8, 'I');
+	mmc_sim_stuff(cid, 64, 8, 'M');
+	mmc_sim_stuff(cid, 56, 8, 0x10);		/* PRV */
+	mmc_sim_stuff(cid, 24, 32, 0x5d000001);		/* PSN */
+	mmc_sim_stuff(cid, 12, 8, 11);			/* MDT year - 2000 */
+	mmc_sim_stuff(cid, 8, 4, 1);			/* MDT month */
+
+	/* CSD version 2.0, as on SDHC cards */
+	mmc_sim_stuff(csd, 126, 2, 1);
+	mmc_sim_stuff(csd, 112, 8, 0x0e);		/* TAAC: 1ms */
+	mmc_sim_stuff(csd, 96, 8, 0x32);		/* TRAN_SPEED: 25MHz */
+	mmc_sim_stuff(csd, 84, 12, SIM_SD_CCC);
+	mmc_sim_stuff(csd, 80, 4, 9);			/* READ_BL_LEN */
+	mmc_sim_stuff(csd, 48, 22, (sim->user_size >> 19) - 1);	/* C_SIZE */
+	mmc_sim_stuff(csd, 46, 1, 1);			/* ERASE_BLK_EN */
+	mmc_sim_stuff(csd, 39, 7, 0x7f);		/* SECTOR_SIZE */
+	mmc_sim_stuff(csd, 26, 3, 2);			/* R2W_FACTOR */
+	mmc_sim_stuff(csd, 22, 4, 9);			/* WRITE_BL_LEN */
+}
+
+static void mmc_sim_build_mmc_regs(struct mmc_sim_host *sim)
+{
+	u32 *cid = sim->cid, *csd = sim->csd;
+	u8 *ext_csd = sim->ext_csd;
+	u32 sectors = sim->user_size >> 9;
+
+	mmc_sim_stuff(cid, 120, 8, 0x00);		/* MID */
+	mmc_sim_stuff(cid, 104, 16, 0x0100);		/* CBX, OID */
+	mmc_sim_stuff(cid, 96, 8, 'M');			/* PNM */
+	mmc_sim_stuff(cid, 88, 8, 'M');
+	mmc_sim_stuff(cid, 80, 8, 'C');
+	mmc_sim_stuff(cid, 72, 8, 'S');
+	mmc_sim_stuff(cid, 64, 8, 'I');
+	mmc_sim_stuff(cid, 56, 8, 'M');
+	mmc_sim_stuff(cid, 48, 8, 0x10);		/* PRV */
+	mmc_sim_stuff(cid, 16, 32, 0x5d000001);		/* PSN */
+	mmc_sim_stuff(cid, 12, 4, 1);			/* MDT month */
+	mmc_sim_stuff(cid, 8, 4, 14);			/* MDT year - 1997 */
+
+	/*
+	 * CSD structure "version coded in EXT_CSD", spec version 4.  The
+	 * card is sector addressed, so C_SIZE is 0xfff and the capacity
+	 * comes from SEC_COUNT.
+	 */
+	mmc_sim_stuff(csd, 126, 2, 3);
+	mmc_sim_stuff(csd, 122, 4, 4);			/* SPEC_VERS */
+	mmc_sim_stuff(csd, 112, 8, 0x27);		/* TAAC: 1.5ms */
+	mmc_sim_stuff(csd, 104, 8, 1);			/* NSAC */
+	mmc_sim_stuff(csd, 96, 8, 0x32);		/* TRAN_SPEED: 26MHz */
+	mmc_sim_stuff(csd, 84, 12, SIM_MMC_CCC);
+	mmc_sim_stuff(csd, 80, 4, 9);			/* READ_BL_LEN */
+	mmc_sim_stuff(csd, 62, 12, 0xfff);		/* C_SIZE */
+	mmc_sim_stuff(csd, 47, 3, 7);			/* C_SIZE_MULT */
+	mmc_sim_stuff(csd, 42, 5, 31);			/* ERASE_GRP_SIZE */
+	mmc_sim_stuff(csd, 37, 5, 15);			/* ERASE_GRP_MULT */
+	mmc_sim_stuff(csd, 26, 3, 2);			/* R2W_FACTOR */
+	mmc_sim_stuff(csd, 22, 4, 9);			/* WRITE_BL_LEN */
+
+	ext_csd[EXT_CSD_WR_REL_PARAM] = EXT_CSD_WR_REL_PARAM_EN;
+	ext_csd[EXT_CSD_REV] = 5;			/* v4.41 */
+	ext_csd[EXT_CSD_STRUCTURE] = 2;
+	ext_csd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_26;
+	if (highspeed)
+		ext_csd[EXT_CSD_CARD_TYPE] |= EXT_CSD_CARD_TYPE_52;
+	ext_csd[EXT_CSD_PART_SWITCH_TIME] = 1;		/* 10ms */
+	ext_csd[EXT_CSD_SEC_CNT + 0] = sectors;
+	ext_csd[EXT_CSD_SEC_CNT + 1] = sectors >> 8;
+	ext_csd[EXT_CSD_SEC_CNT + 2] = sectors >> 16;
+	ext_csd[EXT_CSD_SEC_CNT + 3] = sectors >> 24;
+	ext_csd[EXT_CSD_S_A_TIMEOUT] = 0x10;
+	ext_csd[EXT_CSD_HC_WP_GRP_SIZE] = 1;
+	ext_csd[EXT_CSD_REL_WR_SEC_C] = 1;
+	ext_csd[EXT_CSD_ERASE_TIMEOUT_MULT] = 1;
+	ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE] = 1;		/* 512KiB */
+	ext_csd[EXT_CSD_BOOT_MULT] = sim->boot_size >> 17;
+	ext_csd[EXT_CSD_SEC_TRIM_MULT] = 1;
+	ext_csd[EXT_CSD_SEC_ERASE_MULT] = 1;
+	ext_csd[EXT_CSD_SEC_FEATURE_SUPPORT] = EXT_CSD_SEC_ER_EN |
+					       EXT_CSD_SEC_GB_CL_EN;
+	ext_csd[EXT_CSD_TRIM_MULT] = 1;
+}
+
+/* CMD0 and power off: back to idle with the volatile EXT_CSD fields reset */
+static void mmc_sim_reset(struct mmc_sim_host *sim)
+{
+	sim->state = R1_STATE_IDLE;
+	sim->rca = 0;
+	sim->app_cmd = false;
+	sim->status_clr = 0;
+	sim->sd_function = 0;
+	sim->ext_csd[EXT_CSD_ERASE_GROUP_DEF] = 0;
+	sim->ext_csd[EXT_CSD_PART_CONFIG] = 0;
+	sim->ext_csd[EXT_CSD_BUS_WIDTH] = 0;
+	sim->ext_csd[EXT_CSD_HS_TIMING] = 0;
+}
+
+static u32 mmc_sim_status(struct mmc_sim_host *sim)
+{
+	u32 status = sim->status_clr | R1_READY_FOR_DATA | (sim->state << 9);
+
+	if (sim->app_cmd)
+		status |= R1_APP_CMD;
+	sim->status_clr = 0;
+	return status;
+}
+
+/* Addressed commands are only answered by the card owning the RCA */
+static bool mmc_sim_addressed(struct mmc_sim_host *sim, u32 arg)
+{
+	return sim->state >= R1_STATE_STBY && (arg >> 16) == sim->rca;
+}
+
+static void mmc_sim_sleep(unsigned long us)
+{
+	if (us < 20000)
+		usleep_range(us, us + us / 8 + 1);
+	else
+		msleep(DIV_ROUND_UP(us, 1000));
+}
+
+static void mmc_sim_delay(struct mmc_sim_host *sim, unsigned long us)
+{
+	if (!us)
+		return;
+
+	sim->stats.busy_us += us;
+	mmc_sim_sleep(us);
+}
+
+/*
+ * Prepare the data of a request for DMA.  host_cookie is set once this
+ * has been done, by pre_req or when the request is started.
+ */
+static void mmc_sim_map(struct mmc_sim_host *sim, struct mmc_data *data)
+{
+	unsigned long us;
+
+	if (!data || data->host_cookie)
+		return;
+
+	data->host_cookie = 1;
+	us = div_u64((u64)DIV_ROUND_UP(data->blksz * data->blocks, 1024) *
+		     map_ns_per_kb, NSEC_PER_USEC);
+	if (!us)
+		return;
+
+	sim->stats.map_us += us;
+	mmc_sim_sleep(us);
+}
+
+static unsigned long mmc_sim_xfer_us(struct mmc_sim_host *sim,
+				     unsigned int bytes, unsigned int kbps)
+{
+	u64 us = 0, bus_us;
+
+	if (kbps)
+		us = div_u64((u64)bytes * USEC_PER_SEC, kbps) >> 10;
+
+	if (model_bus && sim->clock) {
+		bus_us = div_u64((u64)bytes * 8 * USEC_PER_SEC,
+				 sim->clock << sim->bus_width);
+		us = max(us, bus_us);
+	}
+
+	return us;
+}
+
+/*
+ * Locate the currently accessible area (user or boot partition) in the
+ * backing store.
+ */
+static u64 mmc_sim_area(struct mmc_sim_host *sim, u64 *size)
+{
+	switch (sim->ext_csd[EXT_CSD_PART_CONFIG] &
+		EXT_CSD_PART_CONFIG_ACC_MASK) {
+	case EXT_CSD_PART_CONFIG_ACC_BOOT0:
+		*size = sim->boot_size;
+		return sim->user_size;
+	case EXT_CSD_PART_CONFIG_ACC_BOOT1:
+		*size = sim->boot_size;
+		return sim->user_size + sim->boot_size;
+	default:
+		*size = sim->user_size;
+		return 0;
+	}
+}
+
+static int mmc_sim_access(struct mmc_sim_host *sim, u64 pos, void *buf,
+			  size_t len, bool write)
+{
+	mm_segment_t old_fs;
+	loff_t off = pos;
+	ssize_t ret;
+
+	if (!sim->filp) {
+		if (write)
+			memcpy(sim->ram + pos, buf, len);
+		else
+			memcpy(buf, sim->ram + pos, len);
+		return 0;
+	}
+
+	old_fs = get_fs();
+	set_fs(KERNEL_DS);
+	if (write)
+		ret = vfs_write(sim->filp, (const char __user *)buf, len, &off);
+	else
+		ret = vfs_read(sim->filp, (char __user *)buf, len, &off);
+	set_fs(old_fs);
+
+	return ret == len ? 0 : -EIO;
+}
+
+static void mmc_sim_erase(struct mmc_sim_host *sim, struct mmc_command *cmd)
+{
+	u64 base, size, pos, end;
+	int err = 0;
+
+	base = mmc_sim_area(sim, &size);
+	if (sim->erase_start > sim->erase_end) {
+		cmd->resp[0] |= R1_ERASE_SEQ_ERROR;
+		return;
+	}
+	if ((u64)sim->erase_end << 9 >= size) {
+		cmd->resp[0] |= R1_OUT_OF_RANGE;
+		return;
+	}
+
+	pos = base + ((u64)sim->erase_start << 9);
+	end = base + ((u64)(sim->erase_end + 1) << 9);
+
+	if (!sim->filp)
+		memset(sim->ram + pos, 0, end - pos);
+	else
+		for (; pos < end && !err; pos += PAGE_SIZE)
+			err = mmc_sim_access(sim, pos,
+					     page_address(ZERO_PAGE(0)),
+					     min_t(u64, end - pos, PAGE_SIZE),
+					     true);
+	if (err)
+		cmd->resp[0] |= R1_ERROR;
+
+	sim->stats.erases++;
+	sim->stats.erase_blocks += sim->erase_end - sim->erase_start + 1;
+	mmc_sim_delay(sim, erase_latency_us);
+}
+
+/* Data phase of a register read (SCR, SD status, switch status, EXT_CSD) */
+static void mmc_sim_send_reg(struct mmc_sim_host *sim, struct mmc_data *data,
+			     void *buf, unsigned int len)
+{
+	if (!data || data->blksz * data->blocks != len) {
+		if (data)
+			data->error = -EINVAL;
+		return;
+	}
+
+	data->bytes_xfered = sg_copy_from_buffer(data->sg, data->sg_len,
+						 buf, len);
+	mmc_sim_delay(sim, mmc_sim_xfer_us(sim, len, 0));
+}
+
+static void mmc_sim_rw(struct mmc_sim_host *sim, struct mmc_command *cmd)
+{
+	struct mmc_data *data = cmd->data;
+	bool write = data->flags & MMC_DATA_WRITE;
+	unsigned int blocks = data->blocks;
+	struct sg_mapping_iter miter;
+	u64 base, size, pos;
+	size_t done = 0, left;
+	bool crc_error = false;
+	int err = 0;
+
+	if (data->blksz != 512) {
+		cmd->resp[0] |= R1_BLOCK_LEN_ERROR;
+		data->error = -ETIMEDOUT;
+		return;
+	}
+
+	base = mmc_sim_area(sim, &size);
+	if (((u64)cmd->arg + blocks) << 9 > size) {
+		cmd->resp[0] |= R1_OUT_OF_RANGE;
+		data->error = -ETIMEDOUT;
+		return;
+	}
+
+	sim->data_reqs++;
+	if (fail_cmd_timeout && sim->data_reqs % fail_cmd_timeout == 0) {
+		sim->stats.cmd_timeouts++;
+		cmd->error = -ETIMEDOUT;
+		return;
+	}
+	if (fail_data_crc && sim->data_reqs % fail_data_crc == 0) {
+		sim->stats.data_crc_errors++;
+		crc_error = true;
+		blocks /= 2;
+	}
+
+	pos = base + ((u64)cmd->arg << 9);
+	left = blocks << 9;
+
+	sg_miter_start(&miter, data->sg, data->sg_len,
+		       write ? SG_MITER_FROM_SG : SG_MITER_TO_SG);
+	while (left && !err && sg_miter_next(&miter)) {
+		size_t len = min(miter.length, left);
+
+		err = mmc_sim_access(sim, pos, miter.addr, len, write);
+		miter.consumed = len;
+		pos += len;
+		left -= len;
+		done += len;
+	}
+	sg_miter_stop(&miter);
+
+	data->bytes_xfered = done;
+	if (err)
+		data->error = err;
+	else if (crc_error)
+		data->error = -EILSEQ;
+
+	if (write) {
+		sim->wr_blocks = done >> 9;
+		sim->stats.writes++;
+		sim->stats.write_blocks += done >> 9;
+		mmc_sim_delay(sim, write_latency_us +
+			      mmc_sim_xfer_us(sim, done, write_kbps));
+	} else {
+		sim->stats.reads++;
+		sim->stats.read_blocks += done >> 9;
+		mmc_sim_delay(sim, read_latency_us +
+			      mmc_sim_xfer_us(sim, done, read_kbps));
+	}
+}
+
+/* CMD6 in SD mode: query or switch function group 1 (bus speed) */
+static void mmc_sim_sd_switch(struct mmc_sim_host *sim,
+			      struct mmc_command *cmd)
+{
+	unsigned int fn = cmd->arg & 0xf;
+	u8 status[64];
+	u8 sel;
+
+	memset(status, 0, sizeof(status));
+	status[1] = 100;			/* 100mA max */
+	status[3] = status[5] = status[7] = status[9] = status[11] = 0x01;
+	status[13] = highspeed ? 0x03 : 0x01;
+
+	if (fn == 0xf)
+		sel = sim->sd_function;
+	else if (fn == 0 || (fn == 1 && highspeed))
+		sel = fn;
+	else
+		sel = 0xf;
+	status[16] = sel;
+
+	if ((cmd->arg & (1 << 31)) && sel != 0xf)
+		sim->sd_function = sel;
+
+	mmc_sim_send_reg(sim, cmd->data, status, sizeof(status));
+}
+
+/* CMD6 in MMC mode: write one of the few writable EXT_CSD bytes */
+static void mmc_sim_mmc_switch(struct mmc_sim_host *sim,
+			       struct mmc_command *cmd)
+{
+	unsigned int index = (cmd->arg >> 16) & 0xff;
+	u8 value = (cmd->arg >> 8) & 0xff;
+	u8 *ext_csd = sim->ext_csd;
+
+	switch ((cmd->arg >> 24) & 0x3) {
+	case MMC_SWITCH_MODE_SET_BITS:
+		value |= ext_csd[index];
+		break;
+	case MMC_SWITCH_MODE_CLEAR_BITS:
+		value = ext_csd[index] & ~value;
+		break;
+	case MMC_SWITCH_MODE_WRITE_BYTE:
+		break;
+	default:
+		return;
+	}
+
+	switch (index) {
+	case EXT_CSD_ERASE_GROUP_DEF:
+	case EXT_CSD_HS_TIMING:
+		if (value > 1)
+			goto error;
+		if (index == EXT_CSD_HS_TIMING && value &&
+		    !(ext_csd[EXT_CSD_CARD_TYPE] & EXT_CSD_CARD_TYPE_52))
+			goto error;
+		break;
+	case EXT_CSD_PART_CONFIG:
+		switch (value & EXT_CSD_PART_CONFIG_ACC_MASK) {
+		case 0:
+			break;
+		case EXT_CSD_PART_CONFIG_ACC_BOOT0:
+		case EXT_CSD_PART_CONFIG_ACC_BOOT1:
+			if (sim->boot_size)
+				break;
+			/* fall through */
+		default:
+			goto error;
+		}
+		break;
+	case EXT_CSD_BUS_WIDTH:
+		if (value > EXT_CSD_BUS_WIDTH_8)
+			goto error;
+		break;
+	default:
+		goto error;
+	}
+
+	ext_csd[index] = value;
+	return;
+
+error:
+	sim->status_clr |= R1_SWITCH_ERROR;
+}
+
+/*
+ * Application specific commands.  Returns false for commands that are
+ * not ACMDs, which the card then executes as regular commands.
+ */
+static bool mmc_sim_acmd(struct mmc_sim_host *sim, struct mmc_command *cmd)
+{
+	u8 scr[8] = { 0x02, 0x05 };	/* SD 2.0, 1 and 4 bit bus */
+	u8 ssr[64];
+	__be32 wr_blocks;
+
+	switch (cmd->opcode) {
+	case SD_APP_OP_COND:
+		if (sim->state > R1_STATE_READY)
+			break;
+		cmd->resp[0] = MMC_CARD_BUSY | SD_OCR_CCS | SIM_OCR;
+		if (cmd->arg)
+			sim->state = R1_STATE_READY;
+		return true;
+	case SD_APP_SET_BUS_WIDTH:
+		if (sim->state != R1_STATE_TRAN)
+			break;
+		cmd->resp[0] = mmc_sim_status(sim);
+		if (cmd->arg != SD_BUS_WIDTH_1 && cmd->arg != SD_BUS_WIDTH_4)
+			cmd->resp[0] |= R1_ERROR;
+		return true;
+	case SD_APP_SD_STATUS:
+		if (sim->state != R1_STATE_TRAN)
+			break;
+		cmd->resp[0] = mmc_sim_status(sim);
+		memset(ssr, 0, sizeof(ssr));
+		ssr[10] = 0x70;			/* AU_SIZE: 1MiB */
+		mmc_sim_send_reg(sim, cmd->data, ssr, sizeof(ssr));
+		return true;
+	case SD_APP_SEND_NUM_WR_BLKS:
+		if (sim->state != R1_STATE_TRAN)
+			break;
+		cmd->resp[0] = mmc_sim_status(sim);
+		wr_blocks = cpu_to_be32(sim->wr_blocks);
+		mmc_sim_send_reg(sim, cmd->data, &wr_blocks, sizeof(wr_blocks));
+		return true;
+	case SD_APP_SEND_SCR:
+		if (sim->state != R1_STATE_TRAN)
+			break;
+		cmd->resp[0] = mmc_sim_status(sim);
+		mmc_sim_send_reg(sim, cmd->data, scr, sizeof(scr));
+		return true;
+	default:
+		return false;
+	}
+
+	cmd->error = -ETIMEDOUT;
+	return true;
+}
+
+static void mmc_sim_cmd(struct mmc_sim_host *sim, struct mmc_command *cmd)
+{
+	bool acmd = sim->app_cmd;
+	u32 arg = cmd->arg;
+
+	sim->stats.cmds++;
+	if (sim->is_sd && acmd && mmc_sim_acmd(sim, cmd)) {
+		sim->app_cmd = false;
+		return;
+	}
+	sim->app_cmd = false;
+
+	switch (cmd->opcode) {
+	case MMC_GO_IDLE_STATE:
+		mmc_sim_reset(sim);
+		return;
+
+	case MMC_SEND_OP_COND:
+		if (sim->is_sd || sim->state > R1_STATE_READY)
+			break;
+		/* Bit 30: sector addressed */
+		cmd->resp[0] = MMC_CARD_BUSY | (1 << 30) | SIM_OCR;
+		if (arg)
+			sim->state = R1_STATE_READY;
+		return;
+
+	case MMC_ALL_SEND_CID:
+		if (sim->state != R1_STATE_READY)
+			break;
+		memcpy(cmd->resp, sim->cid, sizeof(sim->cid));
+		sim->state = R1_STATE_IDENT;
+		return;
+
+	case MMC_SET_RELATIVE_ADDR:
+		if (sim->state != R1_STATE_IDENT &&
+		    (!sim->is_sd || sim->state != R1_STATE_STBY))
+			break;
+		if (sim->is_sd) {
+			/* R6: the card publishes its own address */
+			sim->rca = SIM_SD_RCA;
+			cmd->resp[0] = (sim->rca << 16) | R1_READY_FOR_DATA |
+				       (sim->state << 9);
+		} else {
+			cmd->resp[0] = mmc_sim_status(sim);
+			sim->rca = arg >> 16;
+		}
+		sim->state = R1_STATE_STBY;
+		return;
+
+	case MMC_SWITCH:
+		if (sim->state != R1_STATE_TRAN)
+			break;
+		cmd->resp[0] = mmc_sim_status(sim);
+		if (sim->is_sd)
+			mmc_sim_sd_switch(sim, cmd);
+		else
+			mmc_sim_mmc_switch(sim, cmd);
+		return;
+
+	case MMC_SELECT_CARD:
+		if (sim->state < R1_STATE_STBY)
+			break;
+		if ((arg >> 16) != sim->rca) {
+			/* Deselect: no response expected */
+			sim->state = R1_STATE_STBY;
+			return;
+		}
+		cmd->resp[0] = mmc_sim_status(sim);
+		sim->state = R1_STATE_TRAN;
+		return;
+
+	case MMC_SEND_EXT_CSD:	/* also SD_SEND_IF_COND */
+		if (sim->is_sd) {
+			if (sim->state != R1_STATE_IDLE)
+				break;
+			cmd->resp[0] = arg & 0xfff;
+			return;
+		}
+		if (sim->state != R1_STATE_TRAN || !cmd->data)
+			break;
+		cmd->resp[0] = mmc_sim_status(sim);
+		mmc_sim_send_reg(sim, cmd->data, sim->ext_csd,
+				 sizeof(sim->ext_csd));
+		return;
+
+	case MMC_SEND_CSD:
+	case MMC_SEND_CID:
+		if (sim->state != R1_STATE_STBY || !mmc_sim_addressed(sim, arg))
+			break;
+		memcpy(cmd->resp, cmd->opcode == MMC_SEND_CSD ?
+		       sim->csd : sim->cid, sizeof(cmd->resp));
+		return;
+
+	case MMC_STOP_TRANSMISSION:
+		if (sim->state != R1_STATE_TRAN)
+			break;
+		cmd->resp[0] = mmc_sim_status(sim);
+		return;
+
+	case MMC_SEND_STATUS:
+		if (!mmc_sim_addressed(sim, arg))
+			break;
+		cmd->resp[0] = mmc_sim_status(sim);
+		return;
+
+	case MMC_SET_BLOCKLEN:
+		if (sim->state != R1_STATE_TRAN)
+			break;
+		cmd->resp[0] = mmc_sim_status(sim);
+		if (arg != 512)
+			cmd->resp[0] |= R1_BLOCK_LEN_ERROR;
+		return;
+
+	case MMC_SET_BLOCK_COUNT:
+		if (sim->state != R1_STATE_TRAN)
+			break;
+		cmd->resp[0] = mmc_sim_status(sim);
+		return;
+
+	case MMC_READ_SINGLE_BLOCK:
+	case MMC_READ_MULTIPLE_BLOCK:
+	case MMC_WRITE_BLOCK:
+	case MMC_WRITE_MULTIPLE_BLOCK:
+		if (sim->state != R1_STATE_TRAN || !cmd->data)
+			break;
+		cmd->resp[0] = mmc_sim_status(sim);
+		mmc_sim_rw(sim, cmd);
+		return;
+
+	case SD_ERASE_WR_BLK_START:
+	case MMC_ERASE_GROUP_START:
+		if (sim->state != R1_STATE_TRAN ||
+		    sim->is_sd != (cmd->opcode == SD_ERASE_WR_BLK_START))
+			break;
+		cmd->resp[0] = mmc_sim_status(sim);
+		sim->erase_start = arg;
+		return;
+
+	case SD_ERASE_WR_BLK_END:
+	case MMC_ERASE_GROUP_END:
+		if (sim->state != R1_STATE_TRAN ||
+		    sim->is_sd != (cmd->opcode == SD_ERASE_WR_BLK_END))
+			break;
+		cmd->resp[0] = mmc_sim_status(sim);
+		sim->erase_end = arg;
+		return;
+
+	case MMC_ERASE:
+		if (sim->state != R1_STATE_TRAN)
+			break;
+		cmd->resp[0] = mmc_sim_status(sim);
+		mmc_sim_erase(sim, cmd);
+		return;
+
+	case MMC_APP_CMD:
+		if (!sim->is_sd)
+			break;
+		if (sim->state >= R1_STATE_STBY && !mmc_sim_addressed(sim, arg))
+			break;
+		sim->app_cmd = true;
+		cmd->resp[0] = mmc_sim_status(sim);
+		return;
+	}
+
+	/* Illegal in this state or unsupported: the card does not respond */
+	cmd->error = -ETIMEDOUT;
+}
+
+static void mmc_sim_work(struct work_struct *work)
+{
+	struct mmc_sim_host *sim =
+		container_of(work, struct mmc_sim_host, work);
+	struct mmc_request *mrq = sim->mrq;
+	bool mapped = mrq->data && !mrq->data->host_cookie;
+
+	mmc_sim_map(sim, mrq->data);
+
+	if (mrq->sbc) {
+		mmc_sim_cmd(sim, mrq->sbc);
+		if (mrq->sbc->error)
+			goto done;
+	}
+
+	mmc_sim_cmd(sim, mrq->cmd);
+
+	if (mrq->data && mrq->stop)
+		mmc_sim_cmd(sim, mrq->stop);
+
+done:
+	/* Requests not prepared by pre_req are unmapped as they complete */
+	if (mapped)
+		mrq->data->host_cookie = 0;
+
+	sim->mrq = NULL;
+	mmc_request_done(sim->mmc, mrq);
+}
+
+/* Runs in the caller's context, possibly while a request is in flight */
+static void mmc_sim_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			    bool is_first_req)
+{
+	struct mmc_sim_host *sim = mmc_priv(mmc);
+
+	if (!mrq->data || mrq->data->host_cookie)
+		return;
+
+	/*
+	 * The request in flight was prepared here too, so the work does not
+	 * update map_us concurrently.
+	 */
+	mmc_sim_map(sim, mrq->data);
+	sim->stats.premapped++;
+}
+
+static void mmc_sim_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			     int err)
+{
+	if (mrq->data)
+		mrq->data->host_cookie = 0;
+}
+
+static void mmc_sim_request(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct mmc_sim_host *sim = mmc_priv(mmc);
+
+	WARN_ON(sim->mrq != NULL);
+	sim->mrq = mrq;
+	queue_work(sim->workqueue, &sim->work);
+}
+
+static void mmc_sim_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
+{
+	struct mmc_sim_host *sim = mmc_priv(mmc);
+
+	if (ios->power_mode == MMC_POWER_OFF)
+		mmc_sim_reset(sim);
+
+	sim->clock = ios->clock;
+	sim->bus_width = ios->bus_width;
+}
+
+static int mmc_sim_get_ro(struct mmc_host *mmc)
+{
+	return 0;
+}
+
+static int mmc_sim_get_cd(struct mmc_host *mmc)
+{
+	return 1;
+}
+
+static const struct mmc_host_ops mmc_sim_ops = {
+	.request	= mmc_sim_request,
+	.set_ios	= mmc_sim_set_ios,
+	.get_ro		= mmc_sim_get_ro,
+	.get_cd		= mmc_sim_get_cd,
+};
+
+static const struct mmc_host_ops mmc_sim_async_ops = {
+	.pre_req	= mmc_sim_pre_req,
+	.post_req	= mmc_sim_post_req,
+	.request	= mmc_sim_request,
+	.set_ios	= mmc_sim_set_ios,
+	.get_ro		= mmc_sim_get_ro,
+	.get_cd		= mmc_sim_get_cd,
+};
+
+static int mmc_sim_stats_show(struct seq_file *s, void *unused)
+{
+	struct mmc_sim_host *sim = s->private;
+	struct mmc_sim_stats *st = &sim->stats;
+
+	seq_printf(s, "commands:        %llu\n", st->cmds);
+	seq_printf(s, "reads:           %llu\n", st->reads);
+	seq_printf(s, "read_blocks:     %llu\n", st->read_blocks);
+	seq_printf(s, "writes:          %llu\n", st->writes);
+	seq_printf(s, "write_blocks:    %llu\n", st->write_blocks);
+	seq_printf(s, "erases:          %llu\n", st->erases);
+	seq_printf(s, "erase_blocks:    %llu\n", st->erase_blocks);
+	seq_printf(s, "cmd_timeouts:    %llu\n", st->cmd_timeouts);
+	seq_printf(s, "data_crc_errors: %llu\n", st->data_crc_errors);
+	seq_printf(s, "busy_us:         %llu\n", st->busy_us);
+	seq_printf(s, "map_us:          %llu\n", st->map_us);
+	seq_printf(s, "premapped:       %llu\n", st->premapped);
+
+	return 0;
+}
+
+static int mmc_sim_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_sim_stats_show, inode->i_private);
+}
+
+static const struct file_operations mmc_sim_stats_fops = {
+	.open		= mmc_sim_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int mmc_sim_init_store(struct mmc_sim_host *sim)
+{
+	u64 size;
+
+	if (!sim->is_sd)
+		sim->boot_size = (u64)roundup(boot_kb, 128) << 10;
+
+	if (!image) {
+		sim->user_size = (u64)size_mb << 20;
+		if (!sim->user_size)
+			return -EINVAL;
+		sim->ram = vzalloc(sim->user_size + 2 * sim->boot_size);
+		return sim->ram ? 0 : -ENOMEM;
+	}
+
+	sim->filp = filp_open(image, O_RDWR | O_LARGEFILE, 0);
+	if (IS_ERR(sim->filp)) {
+		int err = PTR_ERR(sim->filp);
+
+		sim->filp = NULL;
+		return err;
+	}
+
+	size = i_size_read(sim->filp->f_mapping->host);
+	if (size < 2 * sim->boot_size + SIM_SIZE_UNIT) {
+		filp_close(sim->filp, NULL);
+		sim->filp = NULL;
+		return -EINVAL;
+	}
+	sim->user_size = (size - 2 * sim->boot_size) & ~(u64)(SIM_SIZE_UNIT - 1);
+
+	return 0;
+}
+
+static void mmc_sim_free_store(struct mmc_sim_host *sim)
+{
+	if (sim->filp)
+		filp_close(sim->filp, NULL);
+	vfree(sim->ram);
+}
+
+static int __devinit mmc_sim_probe(struct platform_device *pdev)
+{
+	struct mmc_host *mmc;
+	struct mmc_sim_host *sim;
+	int ret;
+
+	mmc = mmc_alloc_host(sizeof(struct mmc_sim_host), &pdev->dev);
+	if (!mmc)
+		return -ENOMEM;
+
+	sim = mmc_priv(mmc);
+	sim->mmc = mmc;
+
+	if (!strcmp(card, "sd")) {
+		sim->is_sd = true;
+	} else if (strcmp(card, "mmc")) {
+		dev_err(&pdev->dev, "unknown card type \"%s\"\n", card);
+		ret = -EINVAL;
+		goto free_host;
+	}
+
+	ret = mmc_sim_init_store(sim);
+	if (ret) {
+		dev_err(&pdev->dev, "could not set up backing store: %d\n",
+			ret);
+		goto free_host;
+	}
+
+	if (sim->is_sd)
+		mmc_sim_build_sd_regs(sim);
+	else
+		mmc_sim_build_mmc_regs(sim);
+	mmc_sim_reset(sim);
+
+	mmc->ops = async_prep ? &mmc_sim_async_ops : &mmc_sim_ops;
+	mmc->f_min = 400000;
+	mmc->f_max = f_max;
+	mmc->ocr_avail = MMC_VDD_32_33 | MMC_VDD_33_34;
+	mmc->caps = MMC_CAP_WAIT_WHILE_BUSY | MMC_CAP_ERASE;
+	if (bus_width >= 4)
+		mmc->caps |= MMC_CAP_4_BIT_DATA;
+	if (bus_width >= 8)
+		mmc->caps |= MMC_CAP_8_BIT_DATA;
+	if (highspeed)
+		mmc->caps |= MMC_CAP_MMC_HIGHSPEED | MMC_CAP_SD_HIGHSPEED;
+	if (cmd23)
+		mmc->caps |= MMC_CAP_CMD23;
+
+	mmc->max_segs = clamp(max_segs, 1U, 128U);
+	mmc->max_blk_size = 512;
+	mmc->max_blk_count = clamp(max_blk_count, 1U, 65535U);
+	mmc->max_req_size = mmc->max_blk_count * 512;
+	mmc->max_seg_size = mmc->max_req_size;
+
+	sim->workqueue = create_singlethread_workqueue(DRIVER_NAME);
+	if (!sim->workqueue) {
+		ret = -ENOMEM;
+		goto free_store;
+	}
+	INIT_WORK(&sim->work, mmc_sim_work);
+
+	platform_set_drvdata(pdev, mmc);
+
+	ret = mmc_add_host(mmc);
+	if (ret)
+		goto destroy_wq;
+
+	/* Removed along with the host's own debugfs directory */
+	if (mmc->debugfs_root)
+		debugfs_create_file("sim_stats", S_IRUSR, mmc->debugfs_root,
+				    sim, &mmc_sim_stats_fops);
+
+	dev_info(&pdev->dev, "%s card, %llu KiB%s\n",
+		 sim->is_sd ? "SD" : "MMC", sim->user_size >> 10,
+		 sim->filp ? " (image)" : "");
+
+	return 0;
+
+destroy_wq:
+	platform_set_drvdata(pdev, NULL);
+	destroy_workqueue(sim->workqueue);
+free_store:
+	mmc_sim_free_store(sim);
+free_host:
+	mmc_free_host(mmc);
+	return ret;
+}
+
+static int __devexit mmc_sim_remove(struct platform_device *pdev)
+{
+	struct mmc_host *mmc = platform_get_drvdata(pdev);
+	struct mmc_sim_host *sim = mmc_priv(mmc);
+
+	platform_set_drvdata(pdev, NULL);
+
+	mmc_remove_host(mmc);
+	destroy_workqueue(sim->workqueue);
+	mmc_sim_free_store(sim);
+	mmc_free_host(mmc);
+
+	return 0;
+}
+
+static struct platform_driver mmc_sim_driver = {
+	.probe		= mmc_sim_probe,
+	.remove		= __devexit_p(mmc_sim_remove),
+	.driver		= {
+		.name	= DRIVER_NAME,
+		.owner	= THIS_MODULE,
+	},
+};
+
+static struct platform_device *mmc_sim_device;
+
+static int __init mmc_sim_init(void)
+{
+	int ret;
+
+	ret = platform_driver_register(&mmc_sim_driver);
+	if (ret)
+		return ret;
+
+	mmc_sim_device = platform_device_register_simple(DRIVER_NAME, -1,
+							 NULL, 0);
+	if (IS_ERR(mmc_sim_device)) {
+		platform_driver_unregister(&mmc_sim_driver);
+		return PTR_ERR(mmc_sim_device);
+	}
+
+	return 0;
+}
+
+static void __exit mmc_sim_exit(void)
+{
+	platform_device_unregister(mmc_sim_device);
+	platform_driver_unregister(&mmc_sim_driver);
+}
+
+module_init(mmc_sim_init);
+module_exit(mmc_sim_exit);
+
+MODULE_DESCRIPTION("Software MMC/SD host emulator");
+MODULE_LICENSE("GPL");
@@ -495,6 +495,12 @@ static int __devinit sdhci_s3c_probe(struct platform_device *pdev)
 	 * support as well. */
 	host->quirks |= SDHCI_QUIRK_BROKEN_DMA;
 
+#else
+
+	/* Without ADMA, chain scatterlists through the SDMA boundary
+	 * interrupt rather than bouncing them in the block layer. */
+	host->quirks2 |= SDHCI_QUIRK2_SDMA_SG_CHAIN;
+
 #endif /* CONFIG_MMC_SDHCI_S3C_DMA */
 
 	/* It seems we do not get an DATA transfer complete on non-busy
@@ -419,6 +419,55 @@ static void sdhci_set_adma_desc(u8 *desc, u32 addr, int len, unsigned cmd)
 	dataddr[0] = cpu_to_le32(addr);
 }
 
+/*
+ * Map the data scatterlist for DMA, or, for the current request, take
+ * over the mapping pre_req already made.  With next set, this is
+ * pre_req mapping the request ahead of time.  Returns the number of
+ * mapped entries, 0 on failure.
+ */
+static int sdhci_pre_dma_transfer(struct sdhci_host *host,
+	struct mmc_data *data, struct sdhci_next *next)
+{
+	int sg_count;
+
+	if (!next && data->host_cookie &&
+	    data->host_cookie != host->next_data.cookie) {
+		printk(KERN_WARNING "%s: invalid cookie %d, next cookie %d\n",
+			mmc_hostname(host->mmc), data->host_cookie,
+			host->next_data.cookie);
+		data->host_cookie = 0;
+	}
+
+	/* Check if the request was already mapped by pre_req */
+	if (next || data->host_cookie != host->next_data.cookie ||
+	    !data->host_cookie) {
+		sg_count = dma_map_sg(mmc_dev(host->mmc), data->sg,
+			data->sg_len, (data->flags & MMC_DATA_READ) ?
+				DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	} else {
+		sg_count = host->next_data.sg_count;
+		host->next_data.sg_count = 0;
+	}
+
+	if (sg_count && next) {
+		next->sg_count = sg_count;
+		data->host_cookie = ++next->cookie < 0 ? 1 : next->cookie;
+	}
+
+	return sg_count;
+}
+
+static void sdhci_unmap_data(struct sdhci_host *host, struct mmc_data *data)
+{
+	/* A request mapped by pre_req is unmapped by post_req */
+	if (data->host_cookie)
+		return;
+
+	dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+		(data->flags & MMC_DATA_READ) ?
+			DMA_FROM_DEVICE : DMA_TO_DEVICE);
+}
+
 static int sdhci_adma_table_pre(struct sdhci_host *host,
 	struct mmc_data *data)
 {
@@ -456,8 +505,7 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 		goto fail;
 	BUG_ON(host->align_addr & 0x3);
 
-	host->sg_count = dma_map_sg(mmc_dev(host->mmc),
-		data->sg, data->sg_len, direction);
+	host->sg_count = sdhci_pre_dma_transfer(host, data, NULL);
 	if (host->sg_count == 0)
 		goto unmap_align;
 
@@ -547,6 +595,8 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 	return 0;
 
 unmap_entries:
+	/* the caller falls back to PIO, so drop a pre_req mapping too */
+	data->host_cookie = 0;
 	dma_unmap_sg(mmc_dev(host->mmc), data->sg,
 		data->sg_len, direction);
 unmap_align:
@@ -598,8 +648,7 @@ static void sdhci_adma_table_post(struct sdhci_host *host,
 		}
 	}
 
-	dma_unmap_sg(mmc_dev(host->mmc), data->sg,
-		data->sg_len, direction);
+	sdhci_unmap_data(host, data);
 }
 
 static u8 sdhci_calc_timeout(struct sdhci_host *host, struct mmc_command *cmd)
@@ -671,6 +720,91 @@ static void sdhci_set_transfer_irqs(struct sdhci_host *host)
 		sdhci_clear_set_irqs(host, dma_irqs, pio_irqs);
 }
 
+/*
+ * SDMA stops at every buffer boundary until it is given the address to
+ * continue from, which is how a scatterlist is chained: every segment
+ * but the last has to end on a boundary.  Returns the largest boundary
+ * that satisfies this, or 0 if there is none.  As for the alignment
+ * quirks, physical and bus addresses are assumed to align alike.
+ */
+static unsigned int sdhci_sdma_boundary(struct mmc_data *data)
+{
+	unsigned int boundary = SDHCI_DEFAULT_BOUNDARY_SIZE;
+	struct scatterlist *sg;
+	int i;
+
+	for_each_sg(data->sg, sg, data->sg_len - 1, i) {
+		u32 end = sg_phys(sg) + sg->length;
+
+		while (end & (boundary - 1))
+			boundary >>= 1;
+		if (boundary < SDHCI_MIN_BOUNDARY_SIZE)
+			return 0;
+	}
+
+	return boundary;
+}
+
+/*
+ * Whether the controller quirks allow this data to be transferred by
+ * DMA.  Used both when the request is started and by pre_req, which
+ * must not map anything that will then be moved by PIO.
+ */
+static bool sdhci_data_dma_ok(struct sdhci_host *host, struct mmc_data *data)
+{
+	struct scatterlist *sg;
+	int i;
+
+	/*
+	 * FIXME: This doesn't account for merging when mapping the
+	 * scatterlist.
+	 */
+	if (host->flags & SDHCI_USE_ADMA) {
+		/*
+		 * As we use 3 byte chunks to work around alignment
+		 * problems, sizes and offsets both have to be checked
+		 * against this quirk.
+		 */
+		if (host->quirks & SDHCI_QUIRK_32BIT_ADMA_SIZE) {
+			for_each_sg(data->sg, sg, data->sg_len, i) {
+				if ((sg->length | sg->offset) & 0x3) {
+					DBG("Reverting to PIO because of "
+						"transfer size or alignment\n");
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	for_each_sg(data->sg, sg, data->sg_len, i) {
+		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_SIZE) &&
+		    (sg->length & 0x3)) {
+			DBG("Reverting to PIO because of "
+				"transfer size (%d)\n", sg->length);
+			return false;
+		}
+		/*
+		 * The assumption here being that alignment is the same
+		 * after translation to device address space.
+		 */
+		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
+		    (sg->offset & 0x3)) {
+			DBG("Reverting to PIO because of "
+				"bad alignment\n");
+			return false;
+		}
+	}
+
+	if (data->sg_len > 1 && !sdhci_sdma_boundary(data)) {
+		DBG("Reverting to PIO because segments "
+			"cannot be chained\n");
+		return false;
+	}
+
+	return true;
+}
+
 static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_command *cmd)
 {
 	u8 count;
@@ -696,73 +830,13 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_command *cmd)
 	host->data = data;
 	host->data_early = 0;
 	host->data->bytes_xfered = 0;
+	host->sdma_boundary = SDHCI_DEFAULT_BOUNDARY_SIZE;
 
 	if (host->flags & (SDHCI_USE_SDMA | SDHCI_USE_ADMA))
 		host->flags |= SDHCI_REQ_USE_DMA;
 
-	/*
-	 * FIXME: This doesn't account for merging when mapping the
-	 * scatterlist.
-	 */
-	if (host->flags & SDHCI_REQ_USE_DMA) {
-		int broken, i;
-		struct scatterlist *sg;
-
-		broken = 0;
-		if (host->flags & SDHCI_USE_ADMA) {
-			if (host->quirks & SDHCI_QUIRK_32BIT_ADMA_SIZE)
-				broken = 1;
-		} else {
-			if (host->quirks & SDHCI_QUIRK_32BIT_DMA_SIZE)
-				broken = 1;
-		}
-
-		if (unlikely(broken)) {
-			for_each_sg(data->sg, sg, data->sg_len, i) {
-				if (sg->length & 0x3) {
-					DBG("Reverting to PIO because of "
-						"transfer size (%d)\n",
-						sg->length);
-					host->flags &= ~SDHCI_REQ_USE_DMA;
-					break;
-				}
-			}
-		}
-	}
-
-	/*
-	 * The assumption here being that alignment is the same after
-	 * translation to device address space.
-	 */
-	if (host->flags & SDHCI_REQ_USE_DMA) {
-		int broken, i;
-		struct scatterlist *sg;
-
-		broken = 0;
-		if (host->flags & SDHCI_USE_ADMA) {
-			/*
-			 * As we use 3 byte chunks to work around
-			 * alignment problems, we need to check this
-			 * quirk.
-			 */
-			if (host->quirks & SDHCI_QUIRK_32BIT_ADMA_SIZE)
-				broken = 1;
-		} else {
-			if (host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR)
-				broken = 1;
-		}
-
-		if (unlikely(broken)) {
-			for_each_sg(data->sg, sg, data->sg_len, i) {
-				if (sg->offset & 0x3) {
-					DBG("Reverting to PIO because of "
-						"bad alignment\n");
-					host->flags &= ~SDHCI_REQ_USE_DMA;
-					break;
-				}
-			}
-		}
-	}
+	if ((host->flags & SDHCI_REQ_USE_DMA) && !sdhci_data_dma_ok(host, data))
+		host->flags &= ~SDHCI_REQ_USE_DMA;
 
 	if (host->flags & SDHCI_REQ_USE_DMA) {
 		if (host->flags & SDHCI_USE_ADMA) {
@@ -781,11 +855,7 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_command *cmd)
 		} else {
 			int sg_cnt;
 
-			sg_cnt = dma_map_sg(mmc_dev(host->mmc),
-					data->sg, data->sg_len,
-					(data->flags & MMC_DATA_READ) ?
-						DMA_FROM_DEVICE :
-						DMA_TO_DEVICE);
+			sg_cnt = sdhci_pre_dma_transfer(host, data, NULL);
 			if (sg_cnt == 0) {
 				/*
 				 * This only happens when someone fed
@@ -794,8 +864,14 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_command *cmd)
 				WARN_ON(1);
 				host->flags &= ~SDHCI_REQ_USE_DMA;
 			} else {
-				WARN_ON(sg_cnt != 1);
-				sdhci_writel(host, sg_dma_address(data->sg),
+				WARN_ON(sg_cnt > host->mmc->max_segs);
+				if (sg_cnt > 1)
+					host->sdma_boundary =
+						sdhci_sdma_boundary(data);
+				host->sdma_sg = data->sg;
+				host->sdma_sg_left = sg_cnt - 1;
+				host->sdma_addr = sg_dma_address(data->sg);
+				sdhci_writel(host, host->sdma_addr,
 					SDHCI_DMA_ADDRESS);
 			}
 		}
@@ -832,7 +908,7 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_command *cmd)
 	sdhci_set_transfer_irqs(host);
 
 	/* Set the DMA boundary value and block size */
-	sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
+	sdhci_writew(host, SDHCI_MAKE_BLKSZ((ilog2(host->sdma_boundary) - 12),
 		data->blksz), SDHCI_BLOCK_SIZE);
 	sdhci_writew(host, data->blocks, SDHCI_BLOCK_COUNT);
 }
@@ -883,11 +959,8 @@ static void sdhci_finish_data(struct sdhci_host *host)
 	if (host->flags & SDHCI_REQ_USE_DMA) {
 		if (host->flags & SDHCI_USE_ADMA)
 			sdhci_adma_table_post(host, data);
-		else {
-			dma_unmap_sg(mmc_dev(host->mmc), data->sg,
-				data->sg_len, (data->flags & MMC_DATA_READ) ?
-					DMA_FROM_DEVICE : DMA_TO_DEVICE);
-		}
+		else
+			sdhci_unmap_data(host, data);
 	}
 
 	/*
@@ -1799,7 +1872,60 @@ static void sdhci_enable_preset_value(struct mmc_host *mmc, bool enable)
 	spin_unlock_irqrestore(&host->lock, flags);
 }
 
+/*
+ * Map the data of the next request while the current one is being
+ * transferred, so that the cache maintenance for it is off the critical
+ * path.  Requests the ADMA alignment bounce would have to patch up after
+ * the transfer are left to be mapped at request time.
+ */
+static void sdhci_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
+	bool is_first_req)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	struct scatterlist *sg;
+	int i;
+
+	if (!data)
+		return;
+
+	if (data->host_cookie) {
+		data->host_cookie = 0;
+		return;
+	}
+
+	if (!(host->flags & (SDHCI_USE_SDMA | SDHCI_USE_ADMA)) ||
+	    !sdhci_data_dma_ok(host, data))
+		return;
+
+	if (host->flags & SDHCI_USE_ADMA) {
+		for_each_sg(data->sg, sg, data->sg_len, i)
+			if (sg->offset & 0x3)
+				return;
+	}
+
+	if (!sdhci_pre_dma_transfer(host, data, &host->next_data))
+		data->host_cookie = 0;
+}
+
+static void sdhci_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+	int err)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (!data || !data->host_cookie)
+		return;
+
+	dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+		(data->flags & MMC_DATA_READ) ?
+			DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	data->host_cookie = 0;
+}
+
 static const struct mmc_host_ops sdhci_ops = {
+	.pre_req	= sdhci_pre_req,
+	.post_req	= sdhci_post_req,
 	.request	= sdhci_request,
 	.set_ios	= sdhci_set_ios,
 	.get_ro		= sdhci_get_ro,
@@ -2090,29 +2216,32 @@ static void sdhci_data_irq(struct sdhci_host *host, u32 intmask)
 			sdhci_transfer_pio(host);
 
 		/*
-		 * We currently don't do anything fancy with DMA
-		 * boundaries, but as we can't disable the feature
-		 * we need to at least restart the transfer.
+		 * SDMA pauses at every buffer boundary.  Continue at that
+		 * boundary, or at the next segment once the current one is
+		 * done (they all end on a boundary, see
+		 * sdhci_sdma_boundary()).
 		 *
 		 * According to the spec sdhci_readl(host, SDHCI_DMA_ADDRESS)
 		 * should return a valid address to continue from, but as
 		 * some controllers are faulty, don't trust them.
 		 */
 		if (intmask & SDHCI_INT_DMA_END) {
-			u32 dmastart, dmanow;
-			dmastart = sg_dma_address(host->data->sg);
-			dmanow = dmastart + host->data->bytes_xfered;
-			/*
-			 * Force update to the next DMA block boundary.
-			 */
-			dmanow = (dmanow &
-				~(SDHCI_DEFAULT_BOUNDARY_SIZE - 1)) +
-				SDHCI_DEFAULT_BOUNDARY_SIZE;
-			host->data->bytes_xfered = dmanow - dmastart;
-			DBG("%s: DMA base 0x%08x, transferred 0x%06x bytes,"
-				" next 0x%08x\n",
-				mmc_hostname(host->mmc), dmastart,
-				host->data->bytes_xfered, dmanow);
+			struct scatterlist *sg = host->sdma_sg;
+			u32 dmanow;
+
+			dmanow = (host->sdma_addr &
+				~(host->sdma_boundary - 1)) +
+				host->sdma_boundary;
+			if (host->sdma_sg_left &&
+			    dmanow >= sg_dma_address(sg) + sg_dma_len(sg)) {
+				host->sdma_sg = sg = sg_next(sg);
+				host->sdma_sg_left--;
+				dmanow = sg_dma_address(sg);
+			}
+			DBG("%s: DMA restart at 0x%08x, %d segments left\n",
+				mmc_hostname(host->mmc), dmanow,
+				host->sdma_sg_left);
+			host->sdma_addr = dmanow;
 			sdhci_writel(host, dmanow, SDHCI_DMA_ADDRESS);
 		}
 
@@ -2640,12 +2769,13 @@ int sdhci_add_host(struct sdhci_host *host)
 
 	/*
 	 * Maximum number of segments. Depends on if the hardware
-	 * can do scatter/gather or not.
+	 * can do scatter/gather or not, or SDMA can be chained.
 	 */
 	if (host->flags & SDHCI_USE_ADMA)
 		mmc->max_segs = 128;
 	else if (host->flags & SDHCI_USE_SDMA)
-		mmc->max_segs = 1;
+		mmc->max_segs = (host->quirks2 & SDHCI_QUIRK2_SDMA_SG_CHAIN) ?
+				128 : 1;
 	else /* PIO */
 		mmc->max_segs = 128;
 
@@ -246,6 +246,7 @@
 /*
  * Host SDMA buffer boundary. Valid values from 4K to 512K in powers of 2.
  */
+#define SDHCI_MIN_BOUNDARY_SIZE      (4 * 1024)
 #define SDHCI_DEFAULT_BOUNDARY_SIZE  (512 * 1024)
 #define SDHCI_DEFAULT_BOUNDARY_ARG   (ilog2(SDHCI_DEFAULT_BOUNDARY_SIZE) - 12)
 
@@ -425,6 +425,8 @@ int add_mtd_blktrans_dev(struct mtd_blktrans_dev *new)
 
 	new->rq->queuedata = new;
 	blk_queue_logical_block_size(new->rq, tr->blksize);
+	/* lets the flash elevator batch writes by erase block */
+	blk_queue_io_opt(new->rq, new->mtd->erasesize);
 
 	if (tr->discard) {
 		queue_flag_set_unlocked(QUEUE_FLAG_DISCARD, new->rq);
@@ -727,10 +727,12 @@ static struct file *__dentry_open(struct dentry *dentry, struct vfsmount *mnt,
 		    ((!f->f_mapping->a_ops->direct_IO) &&
 		    (!f->f_mapping->a_ops->get_xip_mem))) {
 			fput(f);
-			f = ERR_PTR(-EINVAL);
+			return ERR_PTR(-EINVAL);
 		}
 	}
 
+	readahead_history_open(f);
+
 	return f;
 
 cleanup_all:
@@ -29,6 +29,7 @@
  * the suspend handlers have already been called without a matching call to the
  * resume handlers, the suspend handler will be called directly from
  * register_early_suspend. This direct call can violate the normal level order.
+ * Handlers with the same level may be called concurrently with each other.
  */
 enum {
 	EARLY_SUSPEND_LEVEL_BLANK_SCREEN = 50,
@@ -41,6 +42,9 @@ struct early_suspend {
 	int level;
 	void (*suspend)(struct early_suspend *h);
 	void (*resume)(struct early_suspend *h);
+	/* Duration of the last and of the slowest calls, in us */
+	unsigned int suspend_us, suspend_max_us;
+	unsigned int resume_us, resume_max_us;
 #endif
 };
 
@@ -1494,6 +1494,20 @@ unsigned long ra_submit(struct file_ra_state *ra,
 			struct address_space *mapping,
 			struct file *filp);
 
+/* readahead_history.c */
+#ifdef CONFIG_READAHEAD_HISTORY
+extern int sysctl_readahead_history;
+void readahead_history_fault(struct file *file, pgoff_t offset);
+void readahead_history_open(struct file *file);
+#else
+static inline void readahead_history_fault(struct file *file, pgoff_t offset)
+{
+}
+static inline void readahead_history_open(struct file *file)
+{
+}
+#endif
+
 /* Generic expand stack which grows the stack according to GROWS{UP,DOWN} */
 extern int expand_stack(struct vm_area_struct *vma, unsigned long address);
 
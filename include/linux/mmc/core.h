@@ -9,6 +9,7 @@
 #define LINUX_MMC_CORE_H
 
 #include <linux/interrupt.h>
+#include <linux/completion.h>
 #include <linux/device.h>
 
 struct request;
@@ -117,6 +118,7 @@ struct mmc_data {
 
 	unsigned int		sg_len;		/* size of scatter list */
 	struct scatterlist	*sg;		/* I/O scatter list */
+	s32			host_cookie;	/* host private data */
 };
 
 struct mmc_request {
@@ -125,13 +127,17 @@ struct mmc_request {
 	struct mmc_data		*data;
 	struct mmc_command	*stop;
 
+	struct completion	completion;	/* used by mmc_start_req */
 	void			*done_data;	/* completion data */
 	void			(*done)(struct mmc_request *);/* completion function */
 };
 
 struct mmc_host;
 struct mmc_card;
+struct mmc_async_req;
 
+extern struct mmc_async_req *mmc_start_req(struct mmc_host *,
+					   struct mmc_async_req *, int *);
 extern void mmc_wait_for_req(struct mmc_host *, struct mmc_request *);
 extern int mmc_wait_for_cmd(struct mmc_host *, struct mmc_command *, int);
 extern int mmc_app_cmd(struct mmc_host *, struct mmc_card *);
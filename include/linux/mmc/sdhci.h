@@ -17,6 +17,11 @@
 #include <linux/io.h>
 #include <linux/mmc/host.h>
 
+struct sdhci_next {
+	unsigned int	sg_count;
+	s32		cookie;
+};
+
 struct sdhci_host {
 	/* Data set by hardware interface driver */
 	const char *hw_name;	/* Hardware bus name */
@@ -88,6 +93,11 @@ struct sdhci_host {
 /* The read-only detection via SDHCI_PRESENT_STATE register is unstable */
 #define SDHCI_QUIRK_UNSTABLE_RO_DETECT			(1<<31)
 
+	unsigned int quirks2;	/* More deviations from spec. */
+
+/* Controller can restart SDMA on another segment at a buffer boundary */
+#define SDHCI_QUIRK2_SDMA_SG_CHAIN			(1<<0)
+
 	int irq;		/* Device IRQ */
 	void __iomem *ioaddr;	/* Mapped address */
 
@@ -134,6 +144,11 @@ struct sdhci_host {
 	unsigned int blocks;	/* remaining PIO blocks */
 
 	int sg_count;		/* Mapped sg entries */
+	struct scatterlist *sdma_sg;	/* SDMA segment in progress */
+	int sdma_sg_left;		/* SDMA segments after it */
+	u32 sdma_addr;			/* SDMA (re)start address */
+	unsigned int sdma_boundary;	/* SDMA buffer boundary */
+	struct sdhci_next next_data;	/* Request mapped by pre_req */
 
 	u8 *adma_desc;		/* ADMA descriptor table */
 	u8 *align_buffer;	/* Bounce buffer */
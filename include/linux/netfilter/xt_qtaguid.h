@@ -10,4 +10,42 @@
 #define XT_QTAGUID_SOCKET XT_OWNER_SOCKET
 #define xt_qtaguid_match_info xt_owner_match_info
 
+/*
+ * Records read from /proc/net/xt_qtaguid/stats_bin.
+ * A read returns one xt_qtaguid_stats_hdr followed by nr_recs
+ * xt_qtaguid_stats_rec, one per {iface, acct_tag, uid, counter set} that
+ * changed since the generation given as the file position.
+ */
+#include <linux/if.h>
+#include <linux/types.h>
+
+#define XT_QTAGUID_STATS_VERSION 1
+
+struct xt_qtaguid_stats_hdr {
+	__u32 version;
+	__u32 rec_size;		/* sizeof(struct xt_qtaguid_stats_rec) */
+	__u64 generation;	/* position to read from next time */
+	__u32 nr_recs;		/* records following this header */
+	__u32 nr_total;		/* records there were, 0 follow if > nr_recs */
+};
+
+/* Indexes into the per protocol counters */
+enum {
+	XT_QTAGUID_PROTO_TCP,
+	XT_QTAGUID_PROTO_UDP,
+	XT_QTAGUID_PROTO_OTHER,
+	XT_QTAGUID_PROTO_MAX
+};
+
+struct xt_qtaguid_stats_rec {
+	char iface[IFNAMSIZ];
+	__u64 acct_tag;		/* in the upper 32 bits, as in stats */
+	__u32 uid;
+	__u32 cnt_set;
+	__u64 rx_bytes[XT_QTAGUID_PROTO_MAX];
+	__u64 rx_packets[XT_QTAGUID_PROTO_MAX];
+	__u64 tx_bytes[XT_QTAGUID_PROTO_MAX];
+	__u64 tx_packets[XT_QTAGUID_PROTO_MAX];
+};
+
 #endif /* _XT_QTAGUID_MATCH_H */
@@ -1559,6 +1559,10 @@ struct task_struct {
 	/* bitmask and counter of trace recursion */
 	unsigned long trace_recursion;
 #endif /* CONFIG_TRACING */
+#ifdef CONFIG_WAKEUP_LATENCY_HIST
+	/* when the task was woken up, for the wakeup latency histograms */
+	u64 wakeup_timestamp_hist;
+#endif
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR /* memcg uses this to do batch job */
 	struct memcg_batch_info {
 		int do_batch;	/* incremented when batch uncharge started */
@@ -2005,6 +2009,10 @@ int sched_rt_handler(struct ctl_table *table, int write,
 		void __user *buffer, size_t *lenp,
 		loff_t *ppos);
 
+#ifdef CONFIG_CFS_BANDWIDTH
+extern unsigned int sysctl_sched_cfs_bandwidth_slice;
+#endif
+
 #ifdef CONFIG_SCHED_AUTOGROUP
 extern unsigned int sysctl_sched_autogroup_enabled;
 
@@ -2240,6 +2248,28 @@ extern long do_fork(unsigned long, unsigned long, struct pt_regs *, unsigned lon
 struct task_struct *fork_idle(int);
 
 extern void set_task_comm(struct task_struct *tsk, char *from);
+
+#ifdef CONFIG_CGROUP_TIMER_SLACK
+extern unsigned long task_min_timer_slack(struct task_struct *tsk);
+#else
+static inline unsigned long task_min_timer_slack(struct task_struct *tsk)
+{
+	return 0;
+}
+#endif
+
+/*
+ * The timer slack of a task's sleeps: its own, raised to the minimum of
+ * its timer_slack cgroup.  Real-time tasks are not subject to the minimum.
+ */
+static inline unsigned long
+task_get_effective_timer_slack(struct task_struct *tsk)
+{
+	if (rt_task(tsk))
+		return tsk->timer_slack_ns;
+
+	return max(tsk->timer_slack_ns, task_min_timer_slack(tsk));
+}
 extern char *get_task_comm(char *to, struct task_struct *tsk);
 
 #ifdef CONFIG_SMP
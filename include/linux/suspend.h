@@ -318,4 +318,40 @@ static inline void unlock_system_sleep(void)
 }
 #endif
 
+/* Phases of a suspend cycle, in order, timed by the suspend profiler */
+enum suspend_phase {
+	SUSPEND_PHASE_FREEZE,		/* freezing tasks */
+	SUSPEND_PHASE_DEVICES,		/* ->prepare() and ->suspend() */
+	SUSPEND_PHASE_NOIRQ,		/* ->suspend_noirq() */
+	SUSPEND_PHASE_CPUS_DOWN,	/* taking non-boot CPUs offline */
+	SUSPEND_PHASE_CORE,		/* syscore suspend */
+	SUSPEND_PHASE_ENTER,		/* platform enter, until wakeup */
+	SUSPEND_PHASE_CORE_RESUME,	/* syscore resume */
+	SUSPEND_PHASE_CPUS_UP,		/* bringing non-boot CPUs back */
+	SUSPEND_PHASE_RESUME_NOIRQ,	/* ->resume_noirq() */
+	SUSPEND_PHASE_RESUME_DEVICES,	/* ->resume() and ->complete() */
+	SUSPEND_PHASE_THAW,		/* thawing tasks */
+	SUSPEND_PHASE_COUNT
+};
+
+#ifdef CONFIG_SUSPEND_PROFILE
+/* kernel/power/suspend_profile.c */
+extern void suspend_profile_start(suspend_state_t state);
+extern void suspend_profile_finish(int error);
+extern void suspend_profile_begin(enum suspend_phase phase);
+extern void suspend_profile_end(enum suspend_phase phase);
+extern void suspend_profile_device(struct device *dev, ktime_t duration);
+extern void suspend_profile_wakeup(const char *source);
+extern void suspend_profile_print_last(void);
+#else
+static inline void suspend_profile_start(suspend_state_t state) {}
+static inline void suspend_profile_finish(int error) {}
+static inline void suspend_profile_begin(enum suspend_phase phase) {}
+static inline void suspend_profile_end(enum suspend_phase phase) {}
+static inline void suspend_profile_device(struct device *dev,
+					  ktime_t duration) {}
+static inline void suspend_profile_wakeup(const char *source) {}
+static inline void suspend_profile_print_last(void) {}
+#endif
+
 #endif /* _LINUX_SUSPEND_H */
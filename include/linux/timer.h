@@ -229,6 +229,20 @@ extern void set_timer_slack(struct timer_list *time, int slack_hz);
  */
 extern unsigned long get_next_timer_interrupt(unsigned long now);
 
+/*
+ * How well the timers of a CPU are coalesced, see /proc/timer_list:
+ */
+struct timer_coalesce_stats {
+	unsigned long	expired;	/* timers run, deferrable ones aside */
+	unsigned long	batched;	/* of which run on a jiffy shared with
+					   an earlier one, sparing a wakeup */
+	unsigned long	coalesced;	/* timers and sleeps rounded to the slack
+					   of their task's timer_slack cgroup */
+};
+
+extern void timer_get_coalesce_stats(int cpu,
+				     struct timer_coalesce_stats *stats);
+
 /*
  * Timer-statistics info:
  */
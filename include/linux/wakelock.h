@@ -18,6 +18,7 @@
 
 #include <linux/list.h>
 #include <linux/ktime.h>
+#include <linux/rbtree.h>
 
 /* A wake_lock prevents the system from entering suspend or other low power
  * states when active. If the type is set to WAKE_LOCK_SUSPEND, the wake_lock
@@ -34,7 +35,9 @@ enum {
 
 struct wake_lock {
 #ifdef CONFIG_HAS_WAKELOCK
-	struct list_head    link;
+	struct list_head    link;		/* all wake locks, for stats */
+	struct list_head    active_link;	/* active locks of its type */
+	struct rb_node      expire_node;	/* active locks with a timeout */
 	int                 flags;
 	const char         *name;
 	unsigned long       expires;
@@ -81,6 +81,29 @@ DEFINE_EVENT(loadeval, cpufreq_interactive_notyet,
 		     unsigned long curfreq, unsigned long targfreq),
 	    TP_ARGS(cpu_id, load, curfreq, targfreq)
 );
+
+DEFINE_EVENT(loadeval, cpufreq_interactive_boosted,
+	    TP_PROTO(unsigned long cpu_id, unsigned long load,
+		     unsigned long curfreq, unsigned long targfreq),
+	    TP_ARGS(cpu_id, load, curfreq, targfreq)
+);
+
+TRACE_EVENT(cpufreq_interactive_boost,
+	    TP_PROTO(unsigned long freq, unsigned long hold_time),
+	    TP_ARGS(freq, hold_time),
+
+	    TP_STRUCT__entry(
+		    __field(unsigned long, freq      )
+		    __field(unsigned long, hold_time )
+	    ),
+
+	    TP_fast_assign(
+		    __entry->freq = freq;
+		    __entry->hold_time = hold_time;
+	    ),
+
+	    TP_printk("freq=%lu hold=%lu", __entry->freq, __entry->hold_time)
+);
 #endif /* _TRACE_CPUFREQ_INTERACTIVE_H */
 
 /* This part must be outside protection */
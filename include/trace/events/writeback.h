@@ -147,11 +147,47 @@ DEFINE_EVENT(wbc_class, name, \
 DEFINE_WBC_EVENT(wbc_writeback_start);
 DEFINE_WBC_EVENT(wbc_writeback_written);
 DEFINE_WBC_EVENT(wbc_writeback_wait);
-DEFINE_WBC_EVENT(wbc_balance_dirty_start);
-DEFINE_WBC_EVENT(wbc_balance_dirty_written);
-DEFINE_WBC_EVENT(wbc_balance_dirty_wait);
 DEFINE_WBC_EVENT(wbc_writepage);
 
+TRACE_EVENT(balance_dirty_pages,
+
+	TP_PROTO(struct backing_dev_info *bdi,
+		 unsigned long bdi_thresh,
+		 unsigned long bdi_dirty,
+		 unsigned long pages_dirtied,
+		 long pause),
+
+	TP_ARGS(bdi, bdi_thresh, bdi_dirty, pages_dirtied, pause),
+
+	TP_STRUCT__entry(
+		__array(	char,		bdi, 32		)
+		__field(	unsigned long,	bdi_thresh	)
+		__field(	unsigned long,	bdi_dirty	)
+		__field(	unsigned long,	write_bw	)
+		__field(	unsigned long,	dirtied		)
+		__field(	unsigned int,	pause		)
+	),
+
+	TP_fast_assign(
+		strlcpy(__entry->bdi, dev_name(bdi->dev), 32);
+		__entry->bdi_thresh	= bdi_thresh;
+		__entry->bdi_dirty	= bdi_dirty;
+		__entry->write_bw	= bdi->avg_write_bandwidth <<
+					  (PAGE_SHIFT - 10);
+		__entry->dirtied	= pages_dirtied;
+		__entry->pause		= pause * 1000 / HZ;
+	),
+
+	TP_printk("bdi %s: bdi_thresh=%lu bdi_dirty=%lu write_bw=%lukB/s "
+		  "dirtied=%lu paused=%ums",
+		  __entry->bdi,
+		  __entry->bdi_thresh,
+		  __entry->bdi_dirty,
+		  __entry->write_bw,
+		  __entry->dirtied,
+		  __entry->pause)
+);
+
 DECLARE_EVENT_CLASS(writeback_congest_waited_template,
 
 	TP_PROTO(unsigned int usec_timeout, unsigned int usec_delayed),
@@ -0,0 +1,145 @@
+/*
+ * cgroup_timer_slack.c - control group timer slack subsystem
+ *
+ * Sets a minimum timer slack for the tasks of a group, so that the timers
+ * of background tasks are coalesced and keep the CPUs idle for longer:
+ * the sleeps of the tasks (nanosleep, select, poll, epoll, futex waits,
+ * interruptible schedule_timeout() sleeps) are allowed to end up to
+ * min_slack_ns late, and so are the deferrable timer_list timers they arm
+ * without a slack of their own, see apply_slack().  Real-time tasks are
+ * left alone.  A group's minimum also applies to its descendants.
+ *
+ * Timers are armed long before cgroup_init(), so the subsystem is set up
+ * early, with a static root group.
+ *
+ * This file is released under the GPLv2.
+ */
+
+#include <linux/cgroup.h>
+#include <linux/cred.h>
+#include <linux/err.h>
+#include <linux/kernel.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+struct timer_slack_cgroup {
+	struct cgroup_subsys_state css;
+	unsigned long min_slack_ns;
+};
+
+static struct timer_slack_cgroup root_timer_slack;
+
+static inline struct timer_slack_cgroup *cgroup_timer_slack(struct cgroup *cgrp)
+{
+	return container_of(cgroup_subsys_state(cgrp, timer_slack_subsys_id),
+			    struct timer_slack_cgroup, css);
+}
+
+/* The largest minimum set on @cgrp and its ancestors */
+static unsigned long effective_min_slack(struct cgroup *cgrp)
+{
+	unsigned long slack = 0;
+
+	for (; cgrp; cgrp = cgrp->parent)
+		slack = max(slack, cgroup_timer_slack(cgrp)->min_slack_ns);
+
+	return slack;
+}
+
+/**
+ * task_min_timer_slack - the minimum timer slack of a task's cgroup
+ * @tsk: the task
+ */
+unsigned long task_min_timer_slack(struct task_struct *tsk)
+{
+	unsigned long slack;
+
+	rcu_read_lock();
+	slack = effective_min_slack(task_subsys_state(tsk,
+					timer_slack_subsys_id)->cgroup);
+	rcu_read_unlock();
+
+	return slack;
+}
+
+static struct cgroup_subsys_state *
+timer_slack_create(struct cgroup_subsys *ss, struct cgroup *cgrp)
+{
+	struct timer_slack_cgroup *tslack;
+
+	if (!cgrp->parent)
+		return &root_timer_slack.css;
+
+	tslack = kzalloc(sizeof(*tslack), GFP_KERNEL);
+	if (!tslack)
+		return ERR_PTR(-ENOMEM);
+
+	return &tslack->css;
+}
+
+static void timer_slack_destroy(struct cgroup_subsys *ss, struct cgroup *cgrp)
+{
+	kfree(cgroup_timer_slack(cgrp));
+}
+
+/* Same rules as for the cpu controller, which it is often mounted with */
+static int timer_slack_allow_attach(struct cgroup *cgrp,
+				    struct task_struct *tsk)
+{
+	const struct cred *cred = current_cred(), *tcred;
+
+	tcred = __task_cred(tsk);
+
+	if ((current != tsk) && !capable(CAP_SYS_NICE) &&
+	    cred->euid != tcred->uid && cred->euid != tcred->suid)
+		return -EACCES;
+
+	return 0;
+}
+
+static u64 min_slack_ns_read(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_timer_slack(cgrp)->min_slack_ns;
+}
+
+static int min_slack_ns_write(struct cgroup *cgrp, struct cftype *cft, u64 val)
+{
+	if (val > ULONG_MAX)
+		return -EINVAL;
+
+	cgroup_timer_slack(cgrp)->min_slack_ns = val;
+	return 0;
+}
+
+static u64 effective_slack_ns_read(struct cgroup *cgrp, struct cftype *cft)
+{
+	return effective_min_slack(cgrp);
+}
+
+static struct cftype files[] = {
+	{
+		.name = "min_slack_ns",
+		.read_u64 = min_slack_ns_read,
+		.write_u64 = min_slack_ns_write,
+	},
+	{
+		.name = "effective_slack_ns",
+		.read_u64 = effective_slack_ns_read,
+	},
+};
+
+static int timer_slack_populate(struct cgroup_subsys *ss, struct cgroup *cgrp)
+{
+	return cgroup_add_files(cgrp, ss, files, ARRAY_SIZE(files));
+}
+
+struct cgroup_subsys timer_slack_subsys = {
+	.name		= "timer_slack",
+	.create		= timer_slack_create,
+	.destroy	= timer_slack_destroy,
+	.allow_attach	= timer_slack_allow_attach,
+	.populate	= timer_slack_populate,
+	.subsys_id	= timer_slack_subsys_id,
+	.early_init	= 1,
+};
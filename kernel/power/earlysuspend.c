@@ -13,10 +13,14 @@
  *
  */
 
+#include <linux/async.h>
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/syscalls.h> /* sys_sync */
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
@@ -31,6 +35,10 @@ enum {
 static int debug_mask = DEBUG_USER_STATE;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* Call the handlers of a level concurrently, rather than one by one */
+static int parallel = 1;
+module_param(parallel, int, S_IRUGO | S_IWUSR | S_IWGRP);
+
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
 static void early_suspend(struct work_struct *work);
@@ -45,6 +53,60 @@ enum {
 };
 static int state;
 
+static LIST_HEAD(early_suspend_domain);
+/* Duration of the last early_suspend() and late_resume() calls, in us */
+static unsigned int early_suspend_us, late_resume_us;
+
+static unsigned int us_since(ktime_t start)
+{
+	return ktime_to_us(ktime_sub(ktime_get(), start));
+}
+
+static void call_early_suspend(void *data, async_cookie_t cookie)
+{
+	struct early_suspend *h = data;
+	ktime_t start;
+
+	if (debug_mask & DEBUG_VERBOSE)
+		pr_info("early_suspend: calling %pf\n", h->suspend);
+	start = ktime_get();
+	h->suspend(h);
+	h->suspend_us = us_since(start);
+	h->suspend_max_us = max(h->suspend_max_us, h->suspend_us);
+}
+
+static void call_late_resume(void *data, async_cookie_t cookie)
+{
+	struct early_suspend *h = data;
+	ktime_t start;
+
+	if (debug_mask & DEBUG_VERBOSE)
+		pr_info("late_resume: calling %pf\n", h->resume);
+	start = ktime_get();
+	h->resume(h);
+	h->resume_us = us_since(start);
+	h->resume_max_us = max(h->resume_max_us, h->resume_us);
+}
+
+/*
+ * Call a handler, on an async thread if parallel is set.  The handlers of a
+ * level all run before any of the next level: *level is the level of the
+ * handlers still running, to wait for when it changes.
+ * Caller must hold early_suspend_lock.
+ */
+static void call_handler(async_func_ptr *call, struct early_suspend *h,
+			 int *level)
+{
+	if (h->level != *level) {
+		async_synchronize_full_domain(&early_suspend_domain);
+		*level = h->level;
+	}
+	if (parallel)
+		async_schedule_domain(call, h, &early_suspend_domain);
+	else
+		call(h, 0);
+}
+
 void register_early_suspend(struct early_suspend *handler)
 {
 	struct list_head *pos;
@@ -76,6 +138,8 @@ static void early_suspend(struct work_struct *work)
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = INT_MIN;
+	ktime_t start;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -94,13 +158,13 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
+	start = ktime_get();
 	list_for_each_entry(pos, &early_suspend_handlers, link) {
-		if (pos->suspend != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("early_suspend: calling %pf\n", pos->suspend);
-			pos->suspend(pos);
-		}
+		if (pos->suspend != NULL)
+			call_handler(call_early_suspend, pos, &level);
 	}
+	async_synchronize_full_domain(&early_suspend_domain);
+	early_suspend_us = us_since(start);
 	mutex_unlock(&early_suspend_lock);
 
 	if (debug_mask & DEBUG_SUSPEND)
@@ -119,6 +183,8 @@ static void late_resume(struct work_struct *work)
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = INT_MIN;
+	ktime_t start;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -135,16 +201,15 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
+	start = ktime_get();
 	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
-		if (pos->resume != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("late_resume: calling %pf\n", pos->resume);
-
-			pos->resume(pos);
-		}
+		if (pos->resume != NULL)
+			call_handler(call_late_resume, pos, &level);
 	}
+	async_synchronize_full_domain(&early_suspend_domain);
+	late_resume_us = us_since(start);
 	if (debug_mask & DEBUG_SUSPEND)
-		pr_info("late_resume: done\n");
+		pr_info("late_resume: done, %u us\n", late_resume_us);
 abort:
 	mutex_unlock(&early_suspend_lock);
 }
@@ -185,3 +250,52 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int early_suspend_debug_show(struct seq_file *s, void *data)
+{
+	struct early_suspend *pos;
+
+	mutex_lock(&early_suspend_lock);
+	seq_printf(s, "early_suspend %u us, late_resume %u us\n",
+		   early_suspend_us, late_resume_us);
+	seq_printf(s, "level  suspend_us    max_us  resume_us    max_us  "
+		   "handler\n");
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		seq_printf(s, "%5d  %10u %9u %10u %9u  %pf\n", pos->level,
+			   pos->suspend_us, pos->suspend_max_us,
+			   pos->resume_us, pos->resume_max_us,
+			   pos->suspend ? (void *)pos->suspend :
+					  (void *)pos->resume);
+	mutex_unlock(&early_suspend_lock);
+	return 0;
+}
+
+static int early_suspend_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_debug_show, NULL);
+}
+
+static const struct file_operations early_suspend_debug_fops = {
+	.open		= early_suspend_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init early_suspend_debug_init(void)
+{
+	struct dentry *d;
+
+	d = debugfs_create_file("early_suspend", 0444, NULL, NULL,
+				&early_suspend_debug_fops);
+	if (!d) {
+		pr_err("Failed to create early_suspend debug file\n");
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+late_initcall(early_suspend_debug_init);
+#endif
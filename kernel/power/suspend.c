@@ -104,7 +104,9 @@ static int suspend_prepare(void)
 	if (error)
 		goto Finish;
 
+	suspend_profile_begin(SUSPEND_PHASE_FREEZE);
 	error = suspend_freeze_processes();
+	suspend_profile_end(SUSPEND_PHASE_FREEZE);
 	if (!error)
 		return 0;
 
@@ -144,7 +146,9 @@ static int suspend_enter(suspend_state_t state)
 			goto Platform_finish;
 	}
 
+	suspend_profile_begin(SUSPEND_PHASE_NOIRQ);
 	error = dpm_suspend_noirq(PMSG_SUSPEND);
+	suspend_profile_end(SUSPEND_PHASE_NOIRQ);
 	if (error) {
 		printk(KERN_ERR "PM: Some devices failed to power down\n");
 		goto Platform_finish;
@@ -159,33 +163,45 @@ static int suspend_enter(suspend_state_t state)
 	if (suspend_test(TEST_PLATFORM))
 		goto Platform_wake;
 
+	suspend_profile_begin(SUSPEND_PHASE_CPUS_DOWN);
 	error = disable_nonboot_cpus();
+	suspend_profile_end(SUSPEND_PHASE_CPUS_DOWN);
 	if (error || suspend_test(TEST_CPUS))
 		goto Enable_cpus;
 
 	arch_suspend_disable_irqs();
 	BUG_ON(!irqs_disabled());
 
+	suspend_profile_begin(SUSPEND_PHASE_CORE);
 	error = syscore_suspend();
+	suspend_profile_end(SUSPEND_PHASE_CORE);
 	if (!error) {
 		if (!(suspend_test(TEST_CORE) || pm_wakeup_pending())) {
+			suspend_profile_begin(SUSPEND_PHASE_ENTER);
 			error = suspend_ops->enter(state);
+			suspend_profile_end(SUSPEND_PHASE_ENTER);
 			events_check_enabled = false;
 		}
+		suspend_profile_begin(SUSPEND_PHASE_CORE_RESUME);
 		syscore_resume();
+		suspend_profile_end(SUSPEND_PHASE_CORE_RESUME);
 	}
 
 	arch_suspend_enable_irqs();
 	BUG_ON(irqs_disabled());
 
  Enable_cpus:
+	suspend_profile_begin(SUSPEND_PHASE_CPUS_UP);
 	enable_nonboot_cpus();
+	suspend_profile_end(SUSPEND_PHASE_CPUS_UP);
 
  Platform_wake:
 	if (suspend_ops->wake)
 		suspend_ops->wake();
 
+	suspend_profile_begin(SUSPEND_PHASE_RESUME_NOIRQ);
 	dpm_resume_noirq(PMSG_RESUME);
+	suspend_profile_end(SUSPEND_PHASE_RESUME_NOIRQ);
 
  Platform_finish:
 	if (suspend_ops->finish)
@@ -214,7 +230,9 @@ int suspend_devices_and_enter(suspend_state_t state)
 	}
 	suspend_console();
 	suspend_test_start();
+	suspend_profile_begin(SUSPEND_PHASE_DEVICES);
 	error = dpm_suspend_start(PMSG_SUSPEND);
+	suspend_profile_end(SUSPEND_PHASE_DEVICES);
 	if (error) {
 		printk(KERN_ERR "PM: Some devices failed to suspend\n");
 		goto Recover_platform;
@@ -227,7 +245,9 @@ int suspend_devices_and_enter(suspend_state_t state)
 
  Resume_devices:
 	suspend_test_start();
+	suspend_profile_begin(SUSPEND_PHASE_RESUME_DEVICES);
 	dpm_resume_end(PMSG_RESUME);
+	suspend_profile_end(SUSPEND_PHASE_RESUME_DEVICES);
 	suspend_test_finish("resume devices");
 	resume_console();
  Close:
@@ -250,7 +270,9 @@ int suspend_devices_and_enter(suspend_state_t state)
  */
 static void suspend_finish(void)
 {
+	suspend_profile_begin(SUSPEND_PHASE_THAW);
 	suspend_thaw_processes();
+	suspend_profile_end(SUSPEND_PHASE_THAW);
 	usermodehelper_enable();
 	pm_notifier_call_chain(PM_POST_SUSPEND);
 	pm_restore_console();
@@ -281,6 +303,7 @@ int enter_state(suspend_state_t state)
 	printk("done.\n");
 
 	pr_debug("PM: Preparing system for %s sleep\n", pm_states[state]);
+	suspend_profile_start(state);
 	error = suspend_prepare();
 	if (error)
 		goto Unlock;
@@ -297,6 +320,7 @@ int enter_state(suspend_state_t state)
 	pr_debug("PM: Finishing wakeup.\n");
 	suspend_finish();
  Unlock:
+	suspend_profile_finish(error);
 	mutex_unlock(&pm_mutex);
 	return error;
 }
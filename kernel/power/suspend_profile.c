@@ -0,0 +1,310 @@
+/*
+ * kernel/power/suspend_profile.c - where suspend and resume spend their time
+ *
+ * Keeps a ring of the last suspend cycles, each with the time taken by every
+ * phase of the cycle (freezer, device callbacks, syscore, platform enter,
+ * and back), the slowest device callbacks and the wakeup source, in
+ * /sys/kernel/debug/suspend_profile.
+ *
+ * This file is released under the GPLv2.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/device.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/suspend.h>
+#include <linux/time.h>
+
+#include "power.h"
+
+#define SUSPEND_PROFILE_CYCLES		16
+#define SUSPEND_PROFILE_DEVICES		8
+#define SUSPEND_PROFILE_NAME_LEN	24
+
+struct suspend_profile_dev {
+	char			name[SUSPEND_PROFILE_NAME_LEN];
+	enum suspend_phase	phase;
+	u32			us;
+};
+
+struct suspend_profile_cycle {
+	unsigned int		seq;		/* 0 if the slot is unused */
+	suspend_state_t		state;
+	struct timespec		start;
+	bool			done;
+	int			error;
+	u32			phase_us[SUSPEND_PHASE_COUNT];
+	char			wakeup[SUSPEND_PROFILE_NAME_LEN];
+	/* The slowest device callbacks, slowest first */
+	unsigned int		nr_devices;
+	struct suspend_profile_dev devices[SUSPEND_PROFILE_DEVICES];
+};
+
+static const char * const phase_names[SUSPEND_PHASE_COUNT] = {
+	[SUSPEND_PHASE_FREEZE]		= "freeze",
+	[SUSPEND_PHASE_DEVICES]		= "suspend",
+	[SUSPEND_PHASE_NOIRQ]		= "suspend_noirq",
+	[SUSPEND_PHASE_CPUS_DOWN]	= "cpus_down",
+	[SUSPEND_PHASE_CORE]		= "syscore_suspend",
+	[SUSPEND_PHASE_ENTER]		= "enter",
+	[SUSPEND_PHASE_CORE_RESUME]	= "syscore_resume",
+	[SUSPEND_PHASE_CPUS_UP]		= "cpus_up",
+	[SUSPEND_PHASE_RESUME_NOIRQ]	= "resume_noirq",
+	[SUSPEND_PHASE_RESUME_DEVICES]	= "resume",
+	[SUSPEND_PHASE_THAW]		= "thaw",
+};
+
+/* Protects the cycles against the device callbacks and the readers */
+static DEFINE_SPINLOCK(profile_lock);
+static struct suspend_profile_cycle cycles[SUSPEND_PROFILE_CYCLES];
+static unsigned int cycle_seq;
+
+/*
+ * The cycle and phase in progress.  Only the task suspending, under pm_mutex,
+ * changes them.  Phases are timed with local_clock(), because timekeeping is
+ * suspended from syscore suspend to syscore resume; whether the enter phase
+ * includes the time asleep depends on sched_clock() running in suspend.
+ */
+static struct suspend_profile_cycle *cur;
+static int cur_phase = -1;
+static u64 phase_start;
+
+static struct suspend_profile_cycle *last_cycle(void)
+{
+	return cycle_seq ? &cycles[cycle_seq % SUSPEND_PROFILE_CYCLES] : NULL;
+}
+
+/**
+ * suspend_profile_start - start profiling a suspend cycle
+ * @state: the state being entered
+ */
+void suspend_profile_start(suspend_state_t state)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&profile_lock, flags);
+	cur = &cycles[++cycle_seq % SUSPEND_PROFILE_CYCLES];
+	memset(cur, 0, sizeof(*cur));
+	cur->seq = cycle_seq;
+	cur->state = state;
+	getnstimeofday(&cur->start);
+	spin_unlock_irqrestore(&profile_lock, flags);
+}
+
+/**
+ * suspend_profile_finish - end the suspend cycle being profiled
+ * @error: what the cycle returned
+ */
+void suspend_profile_finish(int error)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&profile_lock, flags);
+	if (cur) {
+		cur->error = error;
+		cur->done = true;
+	}
+	cur = NULL;
+	cur_phase = -1;
+	spin_unlock_irqrestore(&profile_lock, flags);
+}
+
+/**
+ * suspend_profile_begin - start timing a phase of the cycle
+ * @phase: the phase
+ *
+ * Device callbacks made until suspend_profile_end() are accounted to @phase.
+ */
+void suspend_profile_begin(enum suspend_phase phase)
+{
+	if (!cur)
+		return;
+	phase_start = local_clock();
+	cur_phase = phase;
+}
+
+/**
+ * suspend_profile_end - stop timing a phase of the cycle
+ * @phase: the phase passed to suspend_profile_begin()
+ */
+void suspend_profile_end(enum suspend_phase phase)
+{
+	if (!cur || cur_phase != phase)
+		return;
+	cur->phase_us[phase] += div_u64(local_clock() - phase_start,
+					NSEC_PER_USEC);
+	cur_phase = -1;
+}
+
+/**
+ * suspend_profile_device - account a device PM callback
+ * @dev: the device
+ * @duration: how long its callback took
+ *
+ * Callbacks made outside of a profiled suspend cycle (runtime PM,
+ * hibernation) are ignored.  May be called concurrently for devices
+ * suspended or resumed asynchronously.
+ */
+void suspend_profile_device(struct device *dev, ktime_t duration)
+{
+	struct suspend_profile_dev *d;
+	unsigned long flags;
+	unsigned int i, n;
+	u32 us;
+
+	if (cur_phase < 0)
+		return;
+	us = ktime_to_us(duration);
+
+	spin_lock_irqsave(&profile_lock, flags);
+	if (!cur || cur_phase < 0)
+		goto out;
+	n = cur->nr_devices;
+	if (n == SUSPEND_PROFILE_DEVICES &&
+	    us <= cur->devices[SUSPEND_PROFILE_DEVICES - 1].us)
+		goto out;
+	/* Insert it in order, dropping the fastest if the table is full */
+	i = min_t(unsigned int, n, SUSPEND_PROFILE_DEVICES - 1);
+	for (; i > 0 && cur->devices[i - 1].us < us; i--)
+		cur->devices[i] = cur->devices[i - 1];
+	d = &cur->devices[i];
+	strlcpy(d->name, dev_name(dev), sizeof(d->name));
+	d->phase = cur_phase;
+	d->us = us;
+	if (n < SUSPEND_PROFILE_DEVICES)
+		cur->nr_devices++;
+out:
+	spin_unlock_irqrestore(&profile_lock, flags);
+}
+
+/**
+ * suspend_profile_wakeup - record what woke the system up
+ * @source: name of the wakeup source
+ *
+ * Only the first source reported after a cycle is kept.  Callable from
+ * interrupt context.
+ */
+void suspend_profile_wakeup(const char *source)
+{
+	struct suspend_profile_cycle *c;
+	unsigned long flags;
+
+	spin_lock_irqsave(&profile_lock, flags);
+	c = last_cycle();
+	if (c && !c->wakeup[0])
+		strlcpy(c->wakeup, source, sizeof(c->wakeup));
+	spin_unlock_irqrestore(&profile_lock, flags);
+}
+
+/* Print to @s, or to the kernel log if @s is NULL */
+#define profile_printf(s, fmt, args...)				\
+	do {							\
+		if (s)						\
+			seq_printf(s, fmt, ##args);		\
+		else						\
+			printk(KERN_INFO fmt, ##args);		\
+	} while (0)
+
+static void show_cycle(struct seq_file *s, struct suspend_profile_cycle *c)
+{
+	u32 total = 0;
+	int i;
+
+	for (i = 0; i < SUSPEND_PHASE_COUNT; i++)
+		if (i != SUSPEND_PHASE_ENTER)
+			total += c->phase_us[i];
+
+	profile_printf(s, "cycle %u: %s at %lu.%03lu, %s, error %d, "
+		       "%u us outside enter, wakeup %s\n", c->seq,
+		       pm_states[c->state] ? pm_states[c->state] : "?",
+		       c->start.tv_sec, c->start.tv_nsec / NSEC_PER_MSEC,
+		       c->done ? "done" : "in progress", c->error, total,
+		       c->wakeup[0] ? c->wakeup : "unknown");
+
+	for (i = 0; i < SUSPEND_PHASE_COUNT; i++)
+		profile_printf(s, "  %-16s %10u us\n", phase_names[i],
+			       c->phase_us[i]);
+	for (i = 0; i < c->nr_devices; i++)
+		profile_printf(s, "  %-16s %10u us  %s\n",
+			       phase_names[c->devices[i].phase],
+			       c->devices[i].us, c->devices[i].name);
+}
+
+/* Copy a cycle out of the ring, so that it is printed without the lock */
+static bool copy_cycle(struct suspend_profile_cycle *dst, unsigned int seq)
+{
+	struct suspend_profile_cycle *c;
+	unsigned long flags;
+	bool ret = false;
+
+	spin_lock_irqsave(&profile_lock, flags);
+	c = &cycles[seq % SUSPEND_PROFILE_CYCLES];
+	if (c->seq == seq) {
+		*dst = *c;
+		ret = true;
+	}
+	spin_unlock_irqrestore(&profile_lock, flags);
+	return ret;
+}
+
+/**
+ * suspend_profile_print_last - print the last suspend cycle in the kernel log
+ */
+void suspend_profile_print_last(void)
+{
+	struct suspend_profile_cycle c;
+
+	if (cycle_seq && copy_cycle(&c, cycle_seq))
+		show_cycle(NULL, &c);
+	else
+		pr_info("PM: no suspend cycle profiled\n");
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int suspend_profile_debug_show(struct seq_file *s, void *data)
+{
+	struct suspend_profile_cycle c;
+	unsigned int last = cycle_seq, seq;
+
+	/* Oldest first */
+	seq = last > SUSPEND_PROFILE_CYCLES ?
+		last - SUSPEND_PROFILE_CYCLES + 1 : 1;
+	for (; seq && seq <= last; seq++)
+		if (copy_cycle(&c, seq))
+			show_cycle(s, &c);
+	return 0;
+}
+
+static int suspend_profile_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_profile_debug_show, NULL);
+}
+
+static const struct file_operations suspend_profile_debug_fops = {
+	.open		= suspend_profile_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init suspend_profile_debug_init(void)
+{
+	struct dentry *d;
+
+	d = debugfs_create_file("suspend_profile", 0444, NULL, NULL,
+				&suspend_profile_debug_fops);
+	if (!d) {
+		pr_err("Failed to create suspend_profile debug file\n");
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+late_initcall(suspend_profile_debug_init);
+#endif
@@ -13,6 +13,7 @@
  *
  */
 
+#include <linux/hrtimer.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/rtc.h>
@@ -40,9 +41,22 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 #define WAKE_LOCK_AUTO_EXPIRE            (1U << 10)
 #define WAKE_LOCK_PREVENTING_SUSPEND     (1U << 11)
 
+/*
+ * All wake locks are on all_wake_locks, and the active ones also on
+ * active_wake_locks[type].  Whether any lock of a type is held is answered
+ * from untimed_count[] and from the earliest and latest deadlines of the
+ * locks with a timeout, which are kept sorted in expire_tree[].  Locks with
+ * a timeout are expired lazily, when looked at, and for suspend locks by
+ * expire_timer at the earliest deadline.
+ */
 static DEFINE_SPINLOCK(list_lock);
-static LIST_HEAD(inactive_locks);
+static LIST_HEAD(all_wake_locks);
 static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+static int untimed_count[WAKE_LOCK_TYPE_COUNT];
+static struct rb_root expire_tree[WAKE_LOCK_TYPE_COUNT];
+static struct wake_lock *expire_first[WAKE_LOCK_TYPE_COUNT];
+static struct wake_lock *expire_last[WAKE_LOCK_TYPE_COUNT];
+static struct hrtimer expire_timer;
 static int current_event_num;
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
@@ -83,7 +97,7 @@ int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 }
 
 
-static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
+static int print_lock_stat(char *buf, size_t size, struct wake_lock *lock)
 {
 	int lock_count = lock->stat.count;
 	int expire_count = lock->stat.expire_count;
@@ -111,7 +125,7 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 			max_time = add_time;
 	}
 
-	return seq_printf(m,
+	return snprintf(buf, size,
 		     "\"%s\"\t%d\t%d\t%d\t%lld\t%lld\t%lld\t%lld\t%lld\n",
 		     lock->name, lock_count, expire_count,
 		     lock->stat.wakeup_count, ktime_to_ns(active_time),
@@ -120,24 +134,61 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 		     ktime_to_ns(lock->stat.last_time));
 }
 
+/*
+ * The stats are formatted a page at a time under list_lock, and copied out
+ * without it.  A cursor, which is an uninitialized wake_lock, keeps the
+ * place in all_wake_locks in between.
+ */
 static int wakelock_stats_show(struct seq_file *m, void *unused)
 {
 	unsigned long irqflags;
+	struct wake_lock cursor = { .flags = 0 };
 	struct wake_lock *lock;
-	int ret;
-	int type;
+	bool done;
+	char *buf;
+	int len, n;
+
+	buf = (char *)__get_free_page(GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	seq_puts(m, "name\tcount\texpire_count\twake_count\tactive_since"
+		 "\ttotal_time\tsleep_time\tmax_time\tlast_change\n");
 
 	spin_lock_irqsave(&list_lock, irqflags);
+	list_add(&cursor.link, &all_wake_locks);
+	spin_unlock_irqrestore(&list_lock, irqflags);
 
-	ret = seq_puts(m, "name\tcount\texpire_count\twake_count\tactive_since"
-			"\ttotal_time\tsleep_time\tmax_time\tlast_change\n");
-	list_for_each_entry(lock, &inactive_locks, link)
-		ret = print_lock_stat(m, lock);
-	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
-		list_for_each_entry(lock, &active_wake_locks[type], link)
-			ret = print_lock_stat(m, lock);
-	}
+	do {
+		len = 0;
+		spin_lock_irqsave(&list_lock, irqflags);
+		lock = &cursor;
+		list_for_each_entry_continue(lock, &all_wake_locks, link) {
+			/* Someone else's cursor */
+			if (!(lock->flags & WAKE_LOCK_INITIALIZED))
+				continue;
+			n = print_lock_stat(buf + len, PAGE_SIZE - len, lock);
+			if (len + n >= PAGE_SIZE) {
+				if (len)
+					break;
+				/* Doesn't fit on its own, take what did */
+				n = PAGE_SIZE - 1;
+			}
+			len += n;
+		}
+		/* Resume from the first lock not printed */
+		list_move_tail(&cursor.link, &lock->link);
+		done = &lock->link == &all_wake_locks;
+		spin_unlock_irqrestore(&list_lock, irqflags);
+
+		seq_write(m, buf, len);
+	} while (!done);
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	list_del(&cursor.link);
 	spin_unlock_irqrestore(&list_lock, irqflags);
+
+	free_page((unsigned long)buf);
 	return 0;
 }
 
@@ -175,7 +226,8 @@ static void update_sleep_wait_stats_locked(int done)
 
 	now = ktime_get();
 	elapsed = ktime_sub(now, last_sleep_time_update);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
+	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND],
+			    active_link) {
 		expired = get_expired_time(lock, &etime);
 		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
 			if (expired)
@@ -195,14 +247,84 @@ static void update_sleep_wait_stats_locked(int done)
 #endif
 
 
+/* Caller must acquire the list_lock spinlock */
+static void expire_tree_insert(struct wake_lock *lock, int type)
+{
+	struct rb_node **p = &expire_tree[type].rb_node;
+	struct rb_node *parent = NULL;
+	struct wake_lock *l;
+
+	while (*p) {
+		parent = *p;
+		l = rb_entry(parent, struct wake_lock, expire_node);
+		if (time_before(lock->expires, l->expires))
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&lock->expire_node, parent, p);
+	rb_insert_color(&lock->expire_node, &expire_tree[type]);
+
+	if (!expire_first[type] ||
+	    time_before(lock->expires, expire_first[type]->expires))
+		expire_first[type] = lock;
+	/* Equal deadlines go to the right, so this is the new last one */
+	if (!expire_last[type] ||
+	    !time_before(lock->expires, expire_last[type]->expires))
+		expire_last[type] = lock;
+}
+
+/* Caller must acquire the list_lock spinlock */
+static void expire_tree_erase(struct wake_lock *lock, int type)
+{
+	struct rb_node *node;
+
+	if (expire_first[type] == lock) {
+		node = rb_next(&lock->expire_node);
+		expire_first[type] = node ?
+			rb_entry(node, struct wake_lock, expire_node) : NULL;
+	}
+	if (expire_last[type] == lock) {
+		node = rb_prev(&lock->expire_node);
+		expire_last[type] = node ?
+			rb_entry(node, struct wake_lock, expire_node) : NULL;
+	}
+	rb_erase(&lock->expire_node, &expire_tree[type]);
+}
+
+/*
+ * Add an active lock to the bookkeeping of its type, according to its
+ * WAKE_LOCK_AUTO_EXPIRE flag and expires.
+ * Caller must acquire the list_lock spinlock
+ */
+static void enqueue_wake_lock(struct wake_lock *lock, int type)
+{
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE)
+		expire_tree_insert(lock, type);
+	else
+		untimed_count[type]++;
+	list_add(&lock->active_link, &active_wake_locks[type]);
+}
+
+/* Caller must acquire the list_lock spinlock */
+static void dequeue_wake_lock(struct wake_lock *lock, int type)
+{
+	if (!(lock->flags & WAKE_LOCK_ACTIVE))
+		return;
+	if (lock->flags & WAKE_LOCK_AUTO_EXPIRE)
+		expire_tree_erase(lock, type);
+	else
+		untimed_count[type]--;
+	list_del_init(&lock->active_link);
+}
+
 static void expire_wake_lock(struct wake_lock *lock)
 {
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 1);
 #endif
+	dequeue_wake_lock(lock, lock->flags & WAKE_LOCK_TYPE_MASK);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
 	if (debug_mask & (DEBUG_WAKE_LOCK | DEBUG_EXPIRE))
 		pr_info("expired wake lock %s\n", lock->name);
 }
@@ -214,7 +336,7 @@ static void print_active_locks(int type)
 	bool print_expired = true;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry(lock, &active_wake_locks[type], link) {
+	list_for_each_entry(lock, &active_wake_locks[type], active_link) {
 		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
 			long timeout = lock->expires - jiffies;
 			if (timeout > 0)
@@ -232,21 +354,47 @@ static void print_active_locks(int type)
 
 static long has_wake_lock_locked(int type)
 {
-	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	struct wake_lock *lock;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
+	/* Each lock is only expired once, so this is O(1) amortized */
+	while ((lock = expire_first[type]) &&
+	       !time_before(jiffies, lock->expires))
+		expire_wake_lock(lock);
+
+	if (untimed_count[type])
+		return -1;
+	if (!expire_last[type])
+		return 0;
+	return expire_last[type]->expires - jiffies;
+}
+
+/*
+ * Arm expire_timer for the earliest suspend lock deadline, or stop it if
+ * there is none, or a lock without a timeout is held anyway.
+ * Caller must acquire the list_lock spinlock, and have expired the locks
+ * that are due (has_wake_lock_locked()).
+ */
+static void update_expire_timer_locked(const char *why)
+{
+	struct wake_lock *lock = expire_first[WAKE_LOCK_SUSPEND];
+	long timeout;
+
+	if (untimed_count[WAKE_LOCK_SUSPEND] || !lock) {
+		/* Never wait for the callback: it takes list_lock */
+		if (hrtimer_try_to_cancel(&expire_timer) > 0 &&
+		    (debug_mask & DEBUG_EXPIRE))
+			pr_info("%s, stop expire timer\n", why);
+		return;
 	}
-	return max_timeout;
+	timeout = lock->expires - jiffies;
+	if (timeout < 1)
+		timeout = 1;
+	if (debug_mask & DEBUG_EXPIRE)
+		pr_info("%s, start expire timer, %ld\n", why, timeout);
+	hrtimer_start(&expire_timer,
+		      ktime_set(timeout / HZ, (timeout % HZ) * (NSEC_PER_SEC / HZ)),
+		      HRTIMER_MODE_REL);
 }
 
 long has_wake_lock(int type)
@@ -316,7 +464,7 @@ static void suspend(struct work_struct *work)
 }
 static DECLARE_WORK(suspend_work, suspend);
 
-static void expire_wake_locks(unsigned long data)
+static enum hrtimer_restart expire_wake_locks(struct hrtimer *timer)
 {
 	long has_lock;
 	unsigned long irqflags;
@@ -330,9 +478,11 @@ static void expire_wake_locks(unsigned long data)
 		pr_info("expire_wake_locks: done, has_lock %ld\n", has_lock);
 	if (has_lock == 0)
 		queue_work(suspend_work_queue, &suspend_work);
+	else
+		update_expire_timer_locked("expire_wake_locks");
 	spin_unlock_irqrestore(&list_lock, irqflags);
+	return HRTIMER_NORESTART;
 }
-static DEFINE_TIMER(expire_timer, expire_wake_locks, 0, 0);
 
 static int power_suspend_late(struct device *dev)
 {
@@ -379,8 +529,10 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
 
 	INIT_LIST_HEAD(&lock->link);
+	INIT_LIST_HEAD(&lock->active_link);
+	RB_CLEAR_NODE(&lock->expire_node);
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_add(&lock->link, &inactive_locks);
+	list_add(&lock->link, &all_wake_locks);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 EXPORT_SYMBOL(wake_lock_init);
@@ -391,7 +543,9 @@ void wake_lock_destroy(struct wake_lock *lock)
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
 	spin_lock_irqsave(&list_lock, irqflags);
-	lock->flags &= ~WAKE_LOCK_INITIALIZED;
+	dequeue_wake_lock(lock, lock->flags & WAKE_LOCK_TYPE_MASK);
+	lock->flags &= ~(WAKE_LOCK_INITIALIZED | WAKE_LOCK_ACTIVE |
+			 WAKE_LOCK_AUTO_EXPIRE);
 #ifdef CONFIG_WAKELOCK_STAT
 	if (lock->stat.count) {
 		deleted_wake_locks.stat.count += lock->stat.count;
@@ -427,6 +581,7 @@ static void wake_lock_internal(
 	if (type == WAKE_LOCK_SUSPEND && wait_for_wakeup) {
 		if (debug_mask & DEBUG_WAKEUP)
 			pr_info("wakeup wake lock: %s\n", lock->name);
+		suspend_profile_wakeup(lock->name);
 		wait_for_wakeup = 0;
 		lock->stat.wakeup_count++;
 	}
@@ -436,13 +591,13 @@ static void wake_lock_internal(
 		lock->stat.last_time = ktime_get();
 	}
 #endif
+	dequeue_wake_lock(lock, type);
 	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
 		lock->flags |= WAKE_LOCK_ACTIVE;
 #ifdef CONFIG_WAKELOCK_STAT
 		lock->stat.last_time = ktime_get();
 #endif
 	}
-	list_del(&lock->link);
 	if (has_timeout) {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d, timeout %ld.%03lu\n",
@@ -450,14 +605,13 @@ static void wake_lock_internal(
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
 		lock->expires = LONG_MAX;
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
-		list_add(&lock->link, &active_wake_locks[type]);
 	}
+	enqueue_wake_lock(lock, type);
 	if (type == WAKE_LOCK_SUSPEND) {
 		current_event_num++;
 #ifdef CONFIG_WAKELOCK_STAT
@@ -466,23 +620,13 @@ static void wake_lock_internal(
 		else if (!wake_lock_active(&main_wake_lock))
 			update_sleep_wait_stats_locked(0);
 #endif
-		if (has_timeout)
-			expire_in = has_wake_lock_locked(type);
-		else
-			expire_in = -1;
-		if (expire_in > 0) {
-			if (debug_mask & DEBUG_EXPIRE)
-				pr_info("wake_lock: %s, start expire timer, "
-					"%ld\n", lock->name, expire_in);
-			mod_timer(&expire_timer, jiffies + expire_in);
-		} else {
-			if (del_timer(&expire_timer))
-				if (debug_mask & DEBUG_EXPIRE)
-					pr_info("wake_lock: %s, stop expire timer\n",
-						lock->name);
-			if (expire_in == 0)
-				queue_work(suspend_work_queue, &suspend_work);
-		}
+		expire_in = has_wake_lock_locked(type);
+		if (debug_mask & DEBUG_EXPIRE)
+			pr_info("wake_lock: %s, has_lock %ld\n",
+				lock->name, expire_in);
+		update_expire_timer_locked("wake_lock");
+		if (expire_in == 0)
+			queue_work(suspend_work_queue, &suspend_work);
 	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
@@ -510,24 +654,16 @@ void wake_unlock(struct wake_lock *lock)
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
+	dequeue_wake_lock(lock, type);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
 	if (type == WAKE_LOCK_SUSPEND) {
 		long has_lock = has_wake_lock_locked(type);
-		if (has_lock > 0) {
-			if (debug_mask & DEBUG_EXPIRE)
-				pr_info("wake_unlock: %s, start expire timer, "
-					"%ld\n", lock->name, has_lock);
-			mod_timer(&expire_timer, jiffies + has_lock);
-		} else {
-			if (del_timer(&expire_timer))
-				if (debug_mask & DEBUG_EXPIRE)
-					pr_info("wake_unlock: %s, stop expire "
-						"timer\n", lock->name);
-			if (has_lock == 0)
-				queue_work(suspend_work_queue, &suspend_work);
-		}
+		if (debug_mask & DEBUG_EXPIRE)
+			pr_info("wake_unlock: %s, has_lock %ld\n",
+				lock->name, has_lock);
+		update_expire_timer_locked("wake_unlock");
+		if (has_lock == 0)
+			queue_work(suspend_work_queue, &suspend_work);
 		if (lock == &main_wake_lock) {
 			if (debug_mask & DEBUG_SUSPEND)
 				print_active_locks(WAKE_LOCK_SUSPEND);
@@ -564,8 +700,12 @@ static int __init wakelocks_init(void)
 	int ret;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
+	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++) {
 		INIT_LIST_HEAD(&active_wake_locks[i]);
+		expire_tree[i] = RB_ROOT;
+	}
+	hrtimer_init(&expire_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	expire_timer.function = expire_wake_locks;
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
@@ -157,6 +157,19 @@ static void print_cpu(struct seq_file *m, int cpu, u64 now)
 #undef P
 #undef P_ns
 
+#define P(x) \
+	SEQ_printf(m, "  .timer_%-9s: %Lu\n", #x, \
+		   (unsigned long long)(stats.x))
+	{
+		struct timer_coalesce_stats stats;
+
+		timer_get_coalesce_stats(cpu, &stats);
+		P(expired);
+		P(batched);
+		P(coalesced);
+	}
+#undef P
+
 #ifdef CONFIG_TICK_ONESHOT
 # define P(x) \
 	SEQ_printf(m, "  .%-15s: %Lu\n", #x, \
@@ -259,7 +272,7 @@ static int timer_list_show(struct seq_file *m, void *v)
 	u64 now = ktime_to_ns(ktime_get());
 	int cpu;
 
-	SEQ_printf(m, "Timer List Version: v0.6\n");
+	SEQ_printf(m, "Timer List Version: v0.7\n");
 	SEQ_printf(m, "HRTIMER_MAX_CLOCK_BASES: %d\n", HRTIMER_MAX_CLOCK_BASES);
 	SEQ_printf(m, "now at %Ld nsecs\n", (unsigned long long)now);
 
@@ -82,11 +82,14 @@ struct tvec_base {
 	struct tvec tv3;
 	struct tvec tv4;
 	struct tvec tv5;
+	unsigned long nr_expired;
+	unsigned long nr_batched;
 } ____cacheline_aligned;
 
 struct tvec_base boot_tvec_bases;
 EXPORT_SYMBOL(boot_tvec_bases);
 static DEFINE_PER_CPU(struct tvec_base *, tvec_bases) = &boot_tvec_bases;
+static DEFINE_PER_CPU(unsigned long, timers_coalesced);
 
 /* Functions below help us manage 'deferrable' flag */
 static inline unsigned int tbase_get_deferrable(struct tvec_base *base)
@@ -734,40 +737,87 @@ int mod_timer_pending(struct timer_list *timer, unsigned long expires)
 EXPORT_SYMBOL(mod_timer_pending);
 
 /*
- * Decide where to put the timer while taking the slack into account
- *
- * Algorithm:
- *   1) calculate the maximum (absolute) time
- *   2) calculate the highest bit where the expires and new max are different
- *   3) use this bit to make a mask
- *   4) use the bitmask to round down the maximum time, so that all last
+ * Round expires up to the latest time up to expires_limit with the most
+ * low bits cleared:
+ *   1) calculate the highest bit where expires and expires_limit differ
+ *   2) use this bit to make a mask
+ *   3) use the bitmask to round down expires_limit, so that all last
  *      bits are zeros
  */
 static inline
-unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
+unsigned long round_slack(unsigned long expires, unsigned long expires_limit)
 {
-	unsigned long expires_limit, mask;
+	unsigned long mask;
 	int bit;
 
+	mask = expires ^ expires_limit;
+	if (mask == 0)
+		return expires;
+
+	bit = find_last_bit(&mask, BITS_PER_LONG);
+
+	mask = (1 << bit) - 1;
+
+	return expires_limit & ~(mask);
+}
+
+/*
+ * The slack, in jiffies, that the timer_slack cgroup of the current task
+ * allows its timers of delta jiffies, up to delta itself.  Real-time tasks
+ * and interrupt context get none.
+ */
+static long group_slack(long delta)
+{
+	unsigned long min_slack;
+
+	if (delta <= 0 || in_interrupt() || rt_task(current))
+		return 0;
+
+	min_slack = task_min_timer_slack(current);
+	if (!min_slack)
+		return 0;
+
+	return min_t(unsigned long, delta, nsecs_to_jiffies(min_slack));
+}
+
+/*
+ * Decide where to put the timer while taking the slack into account:
+ * the timer may expire up to its slack later, rounded by round_slack().
+ *
+ * Timers without a slack of their own get 0.4% of their timeout.
+ * Deferrable ones, which already tolerate running late, get the minimum
+ * slack of the timer_slack cgroup of the task arming them if it is larger.
+ */
+static inline
+unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
+{
+	unsigned long expires_limit;
+	bool coalesce = false;
+
 	if (timer->slack >= 0) {
 		expires_limit = expires + timer->slack;
 	} else {
 		long delta = expires - jiffies;
+		long slack = delta / 256;
 
-		if (delta < 256)
-			return expires;
+		if (tbase_get_deferrable(timer->base)) {
+			long min_slack = group_slack(delta);
 
-		expires_limit = expires + delta / 256;
-	}
-	mask = expires ^ expires_limit;
-	if (mask == 0)
-		return expires;
+			if (min_slack > slack) {
+				slack = min_slack;
+				coalesce = true;
+			}
+		}
 
-	bit = find_last_bit(&mask, BITS_PER_LONG);
+		if (slack <= 0)
+			return expires;
 
-	mask = (1 << bit) - 1;
+		expires_limit = expires + slack;
+	}
 
-	expires_limit = expires_limit & ~(mask);
+	expires_limit = round_slack(expires, expires_limit);
+	if (coalesce && expires_limit != expires)
+		this_cpu_inc(timers_coalesced);
 
 	return expires_limit;
 }
@@ -1098,6 +1148,7 @@ static inline void __run_timers(struct tvec_base *base)
 		struct list_head work_list;
 		struct list_head *head = &work_list;
 		int index = base->timer_jiffies & TVR_MASK;
+		unsigned long nr_expired = 0;
 
 		/*
 		 * Cascade timers:
@@ -1118,6 +1169,8 @@ static inline void __run_timers(struct tvec_base *base)
 			data = timer->data;
 
 			timer_stats_account_timer(timer);
+			if (!tbase_get_deferrable(timer->base))
+				nr_expired++;
 
 			base->running_timer = timer;
 			detach_timer(timer, 1);
@@ -1126,11 +1179,29 @@ static inline void __run_timers(struct tvec_base *base)
 			call_timer_fn(timer, fn, data);
 			spin_lock_irq(&base->lock);
 		}
+		if (nr_expired) {
+			base->nr_expired += nr_expired;
+			base->nr_batched += nr_expired - 1;
+		}
 	}
 	base->running_timer = NULL;
 	spin_unlock_irq(&base->lock);
 }
 
+/**
+ * timer_get_coalesce_stats - how well the timers of a CPU are coalesced
+ * @cpu: the CPU
+ * @stats: where to store the counters
+ */
+void timer_get_coalesce_stats(int cpu, struct timer_coalesce_stats *stats)
+{
+	struct tvec_base *base = per_cpu(tvec_bases, cpu);
+
+	stats->expired = base->nr_expired;
+	stats->batched = base->nr_batched;
+	stats->coalesced = per_cpu(timers_coalesced, cpu);
+}
+
 #ifdef CONFIG_NO_HZ
 /*
  * Find out when the next timer event is due to happen. This
@@ -1434,7 +1505,7 @@ static void process_timeout(unsigned long __data)
 signed long __sched schedule_timeout(signed long timeout)
 {
 	struct timer_list timer;
-	unsigned long expire;
+	unsigned long expire, expires;
 
 	switch (timeout)
 	{
@@ -1466,9 +1537,25 @@ signed long __sched schedule_timeout(signed long timeout)
 	}
 
 	expire = timeout + jiffies;
+	expires = expire;
+
+	/*
+	 * Interruptible sleeps wait for an event and may be coalesced to
+	 * the slack of the task's timer_slack cgroup; uninterruptible ones,
+	 * msleep() included, are mostly driver delays and are kept as is.
+	 */
+	if (current->state == TASK_INTERRUPTIBLE) {
+		long slack = group_slack(timeout);
+
+		if (slack) {
+			expires = round_slack(expire, expire + slack);
+			if (expires != expire)
+				this_cpu_inc(timers_coalesced);
+		}
+	}
 
 	setup_timer_on_stack(&timer, process_timeout, (unsigned long)current);
-	__mod_timer(&timer, expire, false, TIMER_NOT_PINNED);
+	__mod_timer(&timer, expires, false, TIMER_NOT_PINNED);
 	schedule();
 	del_singleshot_timer_sync(&timer);
 
@@ -0,0 +1,547 @@
+/*
+ * Wakeup and preemption-off latency histograms
+ *
+ * The wakeup and preemptoff tracers keep the single worst latency along
+ * with a trace of how it came about.  These histograms instead count every
+ * occurrence in log2 buckets of microseconds, at the cost of a few
+ * instructions each, so that scheduling latency can be watched continuously
+ * on a running system:
+ *
+ *  latency_hist/wakeup/rt, fair	time from the wakeup of a task until
+ *					it runs, by scheduling class
+ *  latency_hist/wakeup/cgroups		the same, by cpu cgroup
+ *  latency_hist/preemptoff/hist	length of the sections run with
+ *					preemption disabled
+ *
+ * in debugfs.  Each set is started and stopped by writing 1 or 0 to its
+ * "enable" file; writing to latency_hist/reset clears all of them.
+ *
+ * This file is released under the GPLv2.
+ */
+
+#include <linux/cgroup.h>
+#include <linux/debugfs.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/smp.h>
+#include <linux/string.h>
+#include <trace/events/sched.h>
+
+#include "trace.h"
+
+/* Bucket i counts latencies of [2^(i-1), 2^i) us, bucket 0 those under 1us */
+#define LATENCY_HIST_BUCKETS	32
+
+struct latency_hist {
+	unsigned long	samples[LATENCY_HIST_BUCKETS];
+	unsigned long	nr;
+	u64		total_ns;
+	u64		max_ns;
+	/* what the worst latency was seen by */
+	char		max_comm[TASK_COMM_LEN];
+	pid_t		max_pid;
+	unsigned long	max_ip;
+};
+
+static DEFINE_MUTEX(hist_mutex);
+static struct dentry *hist_root;
+
+/*
+ * Account a latency of @ns to @h, seen by task @p or in a section started
+ * at @ip.  Histograms are per cpu and only updated with preemption disabled.
+ */
+static void hist_add(struct latency_hist *h, u64 ns, struct task_struct *p,
+		     unsigned long ip)
+{
+	unsigned long us;
+
+	if (likely(ns <= UINT_MAX))
+		us = (u32)ns / NSEC_PER_USEC;
+	else
+		us = min_t(u64, div_u64(ns, NSEC_PER_USEC), ULONG_MAX);
+
+	h->samples[min(fls(us), LATENCY_HIST_BUCKETS - 1)]++;
+	h->nr++;
+	h->total_ns += ns;
+	if (ns > h->max_ns) {
+		h->max_ns = ns;
+		if (p) {
+			memcpy(h->max_comm, p->comm, TASK_COMM_LEN);
+			h->max_pid = p->pid;
+		} else {
+			h->max_ip = ip;
+		}
+	}
+}
+
+/* Add up a histogram kept by every cpu */
+static void hist_sum(struct latency_hist *sum, struct latency_hist *h)
+{
+	int i;
+
+	for (i = 0; i < LATENCY_HIST_BUCKETS; i++)
+		sum->samples[i] += h->samples[i];
+	sum->nr += h->nr;
+	sum->total_ns += h->total_ns;
+	if (h->max_ns > sum->max_ns) {
+		sum->max_ns = h->max_ns;
+		memcpy(sum->max_comm, h->max_comm, TASK_COMM_LEN);
+		sum->max_pid = h->max_pid;
+		sum->max_ip = h->max_ip;
+	}
+}
+
+static void hist_show(struct seq_file *m, struct latency_hist *h, bool by_task)
+{
+	int i, last;
+
+	seq_printf(m, "#samples %lu\n", h->nr);
+	if (!h->nr)
+		return;
+
+	seq_printf(m, "#avg %llu us\n",
+		   div64_u64(h->total_ns, (u64)h->nr * NSEC_PER_USEC));
+	if (by_task)
+		seq_printf(m, "#max %llu us, %s-%d\n",
+			   div_u64(h->max_ns, NSEC_PER_USEC),
+			   h->max_comm, h->max_pid);
+	else
+		seq_printf(m, "#max %llu us, from %pS\n",
+			   div_u64(h->max_ns, NSEC_PER_USEC),
+			   (void *)h->max_ip);
+
+	for (last = LATENCY_HIST_BUCKETS - 1; last > 0; last--)
+		if (h->samples[last])
+			break;
+	seq_puts(m, "#usecs    samples\n");
+	for (i = 0; i <= last; i++)
+		seq_printf(m, "%10lu %10lu\n", i ? 1UL << (i - 1) : 0,
+			   h->samples[i]);
+}
+
+#ifdef CONFIG_WAKEUP_LATENCY_HIST
+enum {
+	WAKEUP_HIST_RT,
+	WAKEUP_HIST_FAIR,
+	WAKEUP_HIST_CLASSES,
+};
+
+static const char * const wakeup_class_names[WAKEUP_HIST_CLASSES] = {
+	[WAKEUP_HIST_RT]	= "rt",
+	[WAKEUP_HIST_FAIR]	= "fair",
+};
+
+/*
+ * Cgroups get one of the slots below the first time one of their tasks is
+ * woken up; tasks of groups beyond the last slot are accounted to "other".
+ * A slot is identified by the cpu cgroup subsystem state of the group, so
+ * after groups are removed and created, the histograms should be reset.
+ */
+#define WAKEUP_HIST_GROUPS	8
+#define WAKEUP_HIST_NAME_LEN	48
+
+struct wakeup_hist_group {
+	void	*key;
+	char	name[WAKEUP_HIST_NAME_LEN];
+};
+
+struct wakeup_hists {
+	struct latency_hist	class[WAKEUP_HIST_CLASSES];
+#ifdef CONFIG_CGROUP_SCHED
+	struct latency_hist	group[WAKEUP_HIST_GROUPS + 1];
+#endif
+};
+
+static DEFINE_PER_CPU(struct wakeup_hists, wakeup_hists);
+static int wakeup_enabled;
+/* Wakeups stamped before the histograms were enabled are ignored */
+static u64 wakeup_epoch;
+
+#ifdef CONFIG_CGROUP_SCHED
+static struct wakeup_hist_group wakeup_groups[WAKEUP_HIST_GROUPS];
+
+static int wakeup_group(struct task_struct *p)
+{
+	struct cgroup_subsys_state *css;
+	void *key;
+	int i;
+
+	rcu_read_lock();
+	css = task_subsys_state(p, cpu_cgroup_subsys_id);
+	for (i = 0; i < WAKEUP_HIST_GROUPS; i++) {
+		key = ACCESS_ONCE(wakeup_groups[i].key);
+		if (!key) {
+			key = cmpxchg(&wakeup_groups[i].key, NULL, css);
+			if (!key) {
+				cgroup_path(css->cgroup, wakeup_groups[i].name,
+					    WAKEUP_HIST_NAME_LEN);
+				break;
+			}
+		}
+		if (key == css)
+			break;
+	}
+	rcu_read_unlock();
+
+	return i;
+}
+#endif
+
+static void probe_wakeup(void *ignore, struct task_struct *p, int success)
+{
+	/* a running task woken up does not wait to run */
+	if (success && !task_curr(p))
+		p->wakeup_timestamp_hist = local_clock();
+}
+
+static void probe_wakeup_new(void *ignore, struct task_struct *p, int success)
+{
+	/* overrides the timestamp copied from the parent */
+	p->wakeup_timestamp_hist = success ? local_clock() : 0;
+}
+
+static void probe_switch(void *ignore, struct task_struct *prev,
+			 struct task_struct *next)
+{
+	struct wakeup_hists *hists;
+	u64 stamp = next->wakeup_timestamp_hist;
+	u64 now;
+
+	prev->wakeup_timestamp_hist = 0;
+	if (!stamp)
+		return;
+	next->wakeup_timestamp_hist = 0;
+	if (stamp < wakeup_epoch)
+		return;
+
+	now = local_clock();
+	/* the task may have been woken up on a cpu whose clock is ahead */
+	if ((s64)(now - stamp) < 0)
+		now = stamp;
+
+	hists = &__get_cpu_var(wakeup_hists);
+	hist_add(&hists->class[rt_task(next) ? WAKEUP_HIST_RT :
+			       WAKEUP_HIST_FAIR], now - stamp, next, 0);
+#ifdef CONFIG_CGROUP_SCHED
+	hist_add(&hists->group[wakeup_group(next)], now - stamp, next, 0);
+#endif
+}
+
+static void wakeup_hist_unregister(void)
+{
+	unregister_trace_sched_switch(probe_switch, NULL);
+	unregister_trace_sched_wakeup_new(probe_wakeup_new, NULL);
+	unregister_trace_sched_wakeup(probe_wakeup, NULL);
+	tracepoint_synchronize_unregister();
+}
+
+static int wakeup_hist_register(void)
+{
+	int ret;
+
+	ret = register_trace_sched_wakeup(probe_wakeup, NULL);
+	if (ret)
+		return ret;
+
+	ret = register_trace_sched_wakeup_new(probe_wakeup_new, NULL);
+	if (ret)
+		goto fail_wakeup;
+
+	ret = register_trace_sched_switch(probe_switch, NULL);
+	if (ret)
+		goto fail_wakeup_new;
+
+	return 0;
+
+fail_wakeup_new:
+	unregister_trace_sched_wakeup_new(probe_wakeup_new, NULL);
+fail_wakeup:
+	unregister_trace_sched_wakeup(probe_wakeup, NULL);
+	tracepoint_synchronize_unregister();
+	return ret;
+}
+
+static int wakeup_enable_get(void *data, u64 *val)
+{
+	*val = wakeup_enabled;
+	return 0;
+}
+
+static int wakeup_enable_set(void *data, u64 val)
+{
+	int ret = 0;
+
+	mutex_lock(&hist_mutex);
+	if (val && !wakeup_enabled) {
+		wakeup_epoch = local_clock();
+		ret = wakeup_hist_register();
+		if (!ret)
+			wakeup_enabled = 1;
+	} else if (!val && wakeup_enabled) {
+		wakeup_hist_unregister();
+		wakeup_enabled = 0;
+	}
+	mutex_unlock(&hist_mutex);
+
+	return ret;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(wakeup_enable_fops, wakeup_enable_get,
+			wakeup_enable_set, "%llu\n");
+
+static int wakeup_class_show(struct seq_file *m, void *v)
+{
+	long class = (long)m->private;
+	struct latency_hist sum;
+	int cpu;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu)
+		hist_sum(&sum, &per_cpu(wakeup_hists, cpu).class[class]);
+	hist_show(m, &sum, true);
+
+	return 0;
+}
+
+static int wakeup_class_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wakeup_class_show, inode->i_private);
+}
+
+static const struct file_operations wakeup_class_fops = {
+	.open		= wakeup_class_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+#ifdef CONFIG_CGROUP_SCHED
+static int wakeup_groups_show(struct seq_file *m, void *v)
+{
+	struct latency_hist sum;
+	int cpu, i;
+
+	for (i = 0; i <= WAKEUP_HIST_GROUPS; i++) {
+		memset(&sum, 0, sizeof(sum));
+		for_each_possible_cpu(cpu)
+			hist_sum(&sum, &per_cpu(wakeup_hists, cpu).group[i]);
+		if (!sum.nr)
+			continue;
+
+		if (i == WAKEUP_HIST_GROUPS)
+			seq_puts(m, "#cgroup (other)\n");
+		else
+			seq_printf(m, "#cgroup %s\n", wakeup_groups[i].name);
+		hist_show(m, &sum, true);
+		seq_putc(m, '\n');
+	}
+
+	return 0;
+}
+
+static int wakeup_groups_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wakeup_groups_show, NULL);
+}
+
+static const struct file_operations wakeup_groups_fops = {
+	.open		= wakeup_groups_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
+static void wakeup_hist_reset(void)
+{
+#ifdef CONFIG_CGROUP_SCHED
+	int i;
+
+	/* before the cpus clear their histograms, see latency_hist_reset() */
+	for (i = 0; i < WAKEUP_HIST_GROUPS; i++) {
+		wakeup_groups[i].key = NULL;
+		wakeup_groups[i].name[0] = '\0';
+	}
+#endif
+}
+
+static void wakeup_hist_reset_cpu(void)
+{
+	memset(&__get_cpu_var(wakeup_hists), 0, sizeof(struct wakeup_hists));
+}
+
+static void __init wakeup_hist_init(void)
+{
+	struct dentry *dir;
+	long i;
+
+	dir = debugfs_create_dir("wakeup", hist_root);
+	if (!dir)
+		return;
+
+	debugfs_create_file("enable", 0644, dir, NULL, &wakeup_enable_fops);
+	for (i = 0; i < WAKEUP_HIST_CLASSES; i++)
+		debugfs_create_file(wakeup_class_names[i], 0444, dir,
+				    (void *)i, &wakeup_class_fops);
+#ifdef CONFIG_CGROUP_SCHED
+	debugfs_create_file("cgroups", 0444, dir, NULL, &wakeup_groups_fops);
+#endif
+}
+#else
+static inline void wakeup_hist_reset(void) { }
+static inline void wakeup_hist_reset_cpu(void) { }
+static inline void wakeup_hist_init(void) { }
+#endif /* CONFIG_WAKEUP_LATENCY_HIST */
+
+#ifdef CONFIG_PREEMPT_OFF_HIST
+static DEFINE_PER_CPU(struct latency_hist, preemptoff_hist);
+static DEFINE_PER_CPU(u64, preemptoff_start);
+static DEFINE_PER_CPU(unsigned long, preemptoff_ip);
+static int preemptoff_enabled __read_mostly;
+
+/**
+ * preemptoff_hist_start - a preemption-off section starts
+ * @ip: where
+ *
+ * Called by the preemptoff tracer hooks, with preemption disabled.
+ */
+void preemptoff_hist_start(unsigned long ip)
+{
+	if (!preemptoff_enabled)
+		return;
+
+	__this_cpu_write(preemptoff_start, local_clock());
+	__this_cpu_write(preemptoff_ip, ip);
+}
+
+/**
+ * preemptoff_hist_stop - the preemption-off section in progress ends
+ */
+void preemptoff_hist_stop(void)
+{
+	u64 start = __this_cpu_read(preemptoff_start);
+	u64 now;
+
+	if (!start)
+		return;
+	__this_cpu_write(preemptoff_start, 0);
+	if (!preemptoff_enabled)
+		return;
+
+	now = local_clock();
+	if ((s64)(now - start) < 0)
+		return;
+	hist_add(&__get_cpu_var(preemptoff_hist), now - start, NULL,
+		 __this_cpu_read(preemptoff_ip));
+}
+
+static int preemptoff_enable_get(void *data, u64 *val)
+{
+	*val = preemptoff_enabled;
+	return 0;
+}
+
+static int preemptoff_enable_set(void *data, u64 val)
+{
+	preemptoff_enabled = !!val;
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(preemptoff_enable_fops, preemptoff_enable_get,
+			preemptoff_enable_set, "%llu\n");
+
+static int preemptoff_hist_show(struct seq_file *m, void *v)
+{
+	struct latency_hist sum;
+	int cpu;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu)
+		hist_sum(&sum, &per_cpu(preemptoff_hist, cpu));
+	hist_show(m, &sum, false);
+
+	return 0;
+}
+
+static int preemptoff_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, preemptoff_hist_show, NULL);
+}
+
+static const struct file_operations preemptoff_hist_fops = {
+	.open		= preemptoff_hist_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void preemptoff_hist_reset_cpu(void)
+{
+	memset(&__get_cpu_var(preemptoff_hist), 0,
+	       sizeof(struct latency_hist));
+	__this_cpu_write(preemptoff_start, 0);
+}
+
+static void __init preemptoff_hist_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("preemptoff", hist_root);
+	if (!dir)
+		return;
+
+	debugfs_create_file("enable", 0644, dir, NULL,
+			    &preemptoff_enable_fops);
+	debugfs_create_file("hist", 0444, dir, NULL, &preemptoff_hist_fops);
+}
+#else
+static inline void preemptoff_hist_reset_cpu(void) { }
+static inline void preemptoff_hist_init(void) { }
+#endif /* CONFIG_PREEMPT_OFF_HIST */
+
+/* Runs on every cpu with interrupts disabled, so no update is in progress */
+static void latency_hist_reset_cpu(void *info)
+{
+	wakeup_hist_reset_cpu();
+	preemptoff_hist_reset_cpu();
+}
+
+static int latency_hist_reset(void *data, u64 val)
+{
+	mutex_lock(&hist_mutex);
+	/*
+	 * Free the cgroup slots first: a cpu that looked a slot up before
+	 * this point is done with it before it clears its histograms.
+	 */
+	wakeup_hist_reset();
+	on_each_cpu(latency_hist_reset_cpu, NULL, 1);
+	mutex_unlock(&hist_mutex);
+
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(latency_hist_reset_fops, NULL, latency_hist_reset,
+			"%llu\n");
+
+static int __init latency_hist_init(void)
+{
+	hist_root = debugfs_create_dir("latency_hist", NULL);
+	if (!hist_root) {
+		pr_err("Failed to create latency_hist debug directory\n");
+		return -ENOMEM;
+	}
+
+	debugfs_create_file("reset", 0200, hist_root, NULL,
+			    &latency_hist_reset_fops);
+	wakeup_hist_init();
+	preemptoff_hist_init();
+
+	return 0;
+}
+
+late_initcall(latency_hist_init);
@@ -363,6 +363,15 @@ void tracing_start_sched_switch_record(void);
 int register_tracer(struct tracer *type);
 void unregister_tracer(struct tracer *type);
 int is_tracing_stopped(void);
+
+#ifdef CONFIG_PREEMPT_OFF_HIST
+void preemptoff_hist_start(unsigned long ip);
+void preemptoff_hist_stop(void);
+#else
+static inline void preemptoff_hist_start(unsigned long ip) { }
+static inline void preemptoff_hist_stop(void) { }
+#endif
+
 enum trace_file_type {
 	TRACE_FILE_LAT_FMT	= 1,
 	TRACE_FILE_ANNOTATE	= 2,
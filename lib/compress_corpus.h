@@ -0,0 +1,89 @@
+/*
+ * Deterministic corpora for the compression self-tests.
+ *
+ * Used by lib/test-lzo.c and lib/test-compress.c, and by the host program
+ * lib/gen_compress_corpus.c, which writes the same data at build time so
+ * that it can be packed in formats the kernel can only decompress.
+ * Everything is generated bytewise so the result does not depend on the
+ * endianness of the machine producing it.
+ */
+#ifndef _LIB_COMPRESS_CORPUS_H
+#define _LIB_COMPRESS_CORPUS_H
+
+#define CORPUS_SIZE	(64 * 1024)
+
+enum compress_corpus {
+	CORPUS_TEXT,
+	CORPUS_RECORDS,
+	CORPUS_ZERO,
+	CORPUS_RANDOM,
+	NR_CORPUS,
+};
+
+static const char * const corpus_names[NR_CORPUS] = {
+	[CORPUS_TEXT]		= "text",
+	[CORPUS_RECORDS]	= "records",
+	[CORPUS_ZERO]		= "zero",
+	[CORPUS_RANDOM]		= "random",
+};
+
+static const char * const corpus_words[] = {
+	"the", "kernel", "page", "cache", "of", "and", "zram", "swap", "to",
+	"compressed", "block", "device", "memory", "a", "is", "for", "data",
+	"android", "system", "server", "launcher", "in", "on", "with",
+};
+
+static u32 __init corpus_rand(u32 *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+static void __init corpus_put_le32(unsigned char *p, u32 v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+/* Stand-ins for text, binary structures, empty and random pages */
+static void __init fill_corpus(unsigned char *buf, size_t len,
+			       enum compress_corpus kind)
+{
+	u32 seed = 0x4c5a4f31 + kind;
+	size_t i = 0;
+
+	switch (kind) {
+	case CORPUS_TEXT:
+		while (i < len) {
+			const char *w = corpus_words[corpus_rand(&seed) %
+						     ARRAY_SIZE(corpus_words)];
+
+			while (*w && i < len)
+				buf[i++] = *w++;
+			if (i < len)
+				buf[i++] = corpus_rand(&seed) % 11 ? ' ' : '\n';
+		}
+		break;
+	case CORPUS_RECORDS:
+		for (; i + 16 <= len; i += 16) {
+			corpus_put_le32(buf + i, i / 16);
+			corpus_put_le32(buf + i + 4,
+					0xc0000000 + (corpus_rand(&seed) & 0xfff0));
+			corpus_put_le32(buf + i + 8, corpus_rand(&seed) & 0x3);
+			corpus_put_le32(buf + i + 12, 0);
+		}
+		memset(buf + i, 0, len - i);
+		break;
+	case CORPUS_ZERO:
+		memset(buf, 0, len);
+		break;
+	default:
+		for (; i < len; i++)
+			buf[i] = corpus_rand(&seed);
+		break;
+	}
+}
+
+#endif /* _LIB_COMPRESS_CORPUS_H */
@@ -6,27 +6,55 @@
 #define CRCPOLY_LE 0xedb88320
 #define CRCPOLY_BE 0x04c11db7
 
-/* How many bits at a time to use.  Requires a table of 4<<CRC_xx_BITS bytes. */
-/* For less performance-sensitive, use 4 */
-#ifndef CRC_LE_BITS 
-# define CRC_LE_BITS 8
+/*
+ * This is the CRC32c polynomial, as outlined by Castagnoli.
+ * x^32+x^28+x^27+x^26+x^25+x^23+x^22+x^20+x^19+x^18+x^14+x^13+x^11+x^10+x^9+
+ * x^8+x^6+x^0
+ */
+#define CRC32C_POLY_LE 0x82F63B78
+
+/*
+ * How many bits at a time to use.  1, 2 and 4 use a table of 4<<CRC_xx_BITS
+ * bytes.  8 processes a 32-bit word per step with four 1KiB tables
+ * ("slice by 4"); 64 processes 64 bits per step with eight 1KiB tables
+ * ("slice by 8").  For less performance-sensitive, use 4.
+ *
+ * The host table generator gets these on its command line (see
+ * lib/Makefile), since it cannot see the kernel configuration.
+ */
+#ifndef CRC_LE_BITS
+# ifdef CONFIG_CRC32_SLICEBY8
+#  define CRC_LE_BITS 64
+# else
+#  define CRC_LE_BITS 8
+# endif
 #endif
 #ifndef CRC_BE_BITS
-# define CRC_BE_BITS 8
+# ifdef CONFIG_CRC32_SLICEBY8
+#  define CRC_BE_BITS 64
+# else
+#  define CRC_BE_BITS 8
+# endif
 #endif
 
 /*
  * Little-endian CRC computation.  Used with serial bit streams sent
  * lsbit-first.  Be sure to use cpu_to_le32() to append the computed CRC.
  */
-#if CRC_LE_BITS > 8 || CRC_LE_BITS < 1 || CRC_LE_BITS & CRC_LE_BITS-1
-# error CRC_LE_BITS must be a power of 2 between 1 and 8
+#if CRC_LE_BITS != 64 && \
+	(CRC_LE_BITS > 8 || CRC_LE_BITS < 1 || CRC_LE_BITS & CRC_LE_BITS-1)
+# error CRC_LE_BITS must be 64 or a power of 2 between 1 and 8
 #endif
 
 /*
  * Big-endian CRC computation.  Used with serial bit streams sent
  * msbit-first.  Be sure to use cpu_to_be32() to append the computed CRC.
  */
-#if CRC_BE_BITS > 8 || CRC_BE_BITS < 1 || CRC_BE_BITS & CRC_BE_BITS-1
-# error CRC_BE_BITS must be a power of 2 between 1 and 8
+#if CRC_BE_BITS != 64 && \
+	(CRC_BE_BITS > 8 || CRC_BE_BITS < 1 || CRC_BE_BITS & CRC_BE_BITS-1)
+# error CRC_BE_BITS must be 64 or a power of 2 between 1 and 8
 #endif
+
+/* Number of 256-entry tables used by the word-at-a-time code */
+#define CRC_LE_TABLES	(CRC_LE_BITS == 64 ? 8 : 4)
+#define CRC_BE_TABLES	(CRC_BE_BITS == 64 ? 8 : 4)
@@ -0,0 +1,33 @@
+/*
+ * Write one of the compression self-test corpora to stdout, so that the
+ * build can pack it with xz and lzma for lib/test-compress.c.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef uint32_t u32;
+
+#define __init
+#define ARRAY_SIZE(x)	(sizeof(x) / sizeof((x)[0]))
+
+#include "compress_corpus.h"
+
+int main(int argc, char **argv)
+{
+	static unsigned char buf[CORPUS_SIZE];
+	int kind;
+
+	for (kind = 0; kind < NR_CORPUS; kind++)
+		if (argc == 2 && !strcmp(argv[1], corpus_names[kind]))
+			break;
+	if (kind == NR_CORPUS) {
+		fprintf(stderr, "usage: %s <corpus>\n", argv[0]);
+		return 1;
+	}
+
+	fill_corpus(buf, sizeof(buf), kind);
+	if (fwrite(buf, sizeof(buf), 1, stdout) != 1)
+		return 1;
+	return 0;
+}
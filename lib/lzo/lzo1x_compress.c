@@ -11,8 +11,11 @@
  *  Richard Purdie <rpurdie@openedhand.com>
  */
 
+#ifndef STATIC
 #include <linux/module.h>
 #include <linux/kernel.h>
+#endif
+
 #include <linux/lzo.h>
 #include <asm/unaligned.h>
 #include "lzodefs.h"
@@ -93,9 +96,28 @@ match:
 				}
 				*op++ = tt;
 			}
+#ifdef LZO_FAST_UNALIGNED
+			/*
+			 * A match opcode and the end-of-stream marker always
+			 * follow, so the up to 3 bytes written past the run
+			 * are overwritten before the output is complete.
+			 */
+			{
+				const unsigned char *ie = ii + t;
+
+				do {
+					COPY4(op, ii);
+					op += 4;
+					ii += 4;
+				} while (ii < ie);
+				op -= ii - ie;
+				ii = ie;
+			}
+#else
 			do {
 				*op++ = *ii++;
 			} while (--t > 0);
+#endif
 		}
 
 		ip += 3;
@@ -125,6 +147,19 @@ match:
 			end = in_end;
 			m = m_pos + M2_MAX_LEN + 1;
 
+#ifdef LZO_FAST_UNALIGNED
+			while (end - ip >= 4) {
+				u32 v = LZO_GET32(m) ^ LZO_GET32(ip);
+
+				if (v) {
+					m += LZO_MATCHED_BYTES(v);
+					ip += LZO_MATCHED_BYTES(v);
+					break;
+				}
+				m += 4;
+				ip += 4;
+			}
+#endif
 			while (ip < end && *m == *ip) {
 				m++;
 				ip++;
@@ -219,8 +254,11 @@ int lzo1x_1_compress(const unsigned char *in, size_t in_len, unsigned char *out,
 	*out_len = op - out;
 	return LZO_E_OK;
 }
+#ifndef STATIC
 EXPORT_SYMBOL_GPL(lzo1x_1_compress);
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("LZO1X-1 Compressor");
 
+#endif
+
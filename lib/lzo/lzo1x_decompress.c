@@ -24,9 +24,6 @@
 #define HAVE_OP(x, op_end, op) ((size_t)(op_end - op) < (x))
 #define HAVE_LB(m_pos, out, op) (m_pos < out || m_pos >= op)
 
-#define COPY4(dst, src)	\
-		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
-
 int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 			unsigned char *out, size_t *out_len)
 {
@@ -67,6 +64,27 @@ int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 			}
 			t += 15 + *ip++;
 		}
+#ifdef LZO_FAST_UNALIGNED
+		/*
+		 * Copy the whole literal run in 8-byte chunks when both
+		 * buffers have room for the overshoot, which is rewritten
+		 * by whatever follows.
+		 */
+		if (likely(!HAVE_OP(t + 3 + 7, op_end, op) &&
+			   !HAVE_IP(t + 3 + 7, ip_end, ip))) {
+			const unsigned char *ie = ip + t + 3;
+			unsigned char *oe = op + t + 3;
+
+			do {
+				COPY8(op, ip);
+				op += 8;
+				ip += 8;
+			} while (ip < ie);
+			ip = ie;
+			op = oe;
+			goto first_literal_run;
+		}
+#endif
 		if (HAVE_OP(t + 3, op_end, op))
 			goto output_overrun;
 		if (HAVE_IP(t + 4, ip_end, ip))
@@ -183,6 +201,19 @@ match:
 			if (HAVE_OP(t + 3 - 1, op_end, op))
 				goto output_overrun;
 
+#ifdef LZO_FAST_UNALIGNED
+			if ((op - m_pos) >= 8 &&
+			    likely(!HAVE_OP(t + 3 - 1 + 7, op_end, op))) {
+				unsigned char *oe = op + t + 3 - 1;
+
+				do {
+					COPY8(op, m_pos);
+					op += 8;
+					m_pos += 8;
+				} while (op < oe);
+				op = oe;
+			} else
+#endif
 			if (t >= 2 * 4 - (3 - 1) && (op - m_pos) >= 4) {
 				COPY4(op, m_pos);
 				op += 4;
@@ -11,6 +11,9 @@
  *  Richard Purdie <rpurdie@openedhand.com>
  */
 
+#ifndef __LZODEFS_H
+#define __LZODEFS_H
+
 #define LZO_VERSION		0x2020
 #define LZO_VERSION_STRING	"2.02"
 #define LZO_VERSION_DATE	"Oct 17 2005"
@@ -41,3 +44,39 @@
 #define DX2(p, s1, s2)	(((((size_t)((p)[2]) << (s2)) ^ (p)[1]) \
 							<< (s1)) ^ (p)[0])
 #define DX3(p, s1, s2, s3)	((DX2((p)+1, s2, s3) << (s1)) ^ (p)[0])
+
+/*
+ * Word-at-a-time fast paths.  These are only used when the CPU handles
+ * unaligned loads and stores natively (e.g. ARMv6+ with SCTLR.U set, which
+ * the kernel always enables), and never in the boot decompressor (STATIC),
+ * which may run before the MMU and alignment model are set up.
+ */
+#if defined(CONFIG_LZO_FAST_UNALIGNED) && !defined(STATIC)
+#include <linux/bitops.h>
+#include <linux/unaligned/packed_struct.h>
+
+#define LZO_FAST_UNALIGNED	1
+
+#define LZO_GET32(p)		__get_unaligned_cpu32(p)
+#define COPY4(dst, src)	\
+		__put_unaligned_cpu32(__get_unaligned_cpu32(src), (dst))
+
+/* number of leading bytes that matched, given a non-zero xor of two words */
+#if defined(__LITTLE_ENDIAN)
+#define LZO_MATCHED_BYTES(v)	(__ffs(v) >> 3)
+#else
+#define LZO_MATCHED_BYTES(v)	((31 - __fls(v)) >> 3)
+#endif
+
+#else
+#define COPY4(dst, src)	\
+		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
+#endif
+
+#define COPY8(dst, src)	\
+	do {							\
+		COPY4(dst, src);				\
+		COPY4((dst) + 4, (src) + 4);			\
+	} while (0)
+
+#endif /* __LZODEFS_H */
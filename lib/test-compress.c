@@ -0,0 +1,384 @@
+/*
+ * Benchmark for the in-kernel compressors and decompressors.
+ *
+ * LZO1X-1 and deflate are run over each corpus in page-sized blocks (as
+ * zram and zcache use them) and as a single 64KiB block (of the order of
+ * a squashfs block).  For xz and lzma, which the kernel can only
+ * decompress, the same corpora are compressed at build time with the
+ * xz and lzma utilities and only decompression is measured.  Every
+ * result is checked against the original data, then the compression
+ * ratio, compress MB/s and decompress MB/s are reported.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/lzo.h>
+#include <linux/zlib.h>
+#include <linux/xz.h>
+
+#include "compress_corpus.h"
+
+/*
+ * lzma has no exported decompressor; build a private copy of the one
+ * used for initramfs images.  Like that one it is __init, which is fine
+ * since everything here runs from the module init function.
+ */
+#define unlzma		test_unlzma
+#include "decompress_unlzma.c"
+#undef unlzma
+
+static unsigned int iterations = 32;
+module_param(iterations, uint, 0);
+MODULE_PARM_DESC(iterations, "Number of passes over the corpus per measurement");
+
+static int deflate_level = Z_DEFAULT_COMPRESSION;
+module_param(deflate_level, int, 0);
+MODULE_PARM_DESC(deflate_level, "zlib compression level (-1 for default, 1-9)");
+
+struct compress_test {
+	unsigned char *src;
+	unsigned char *comp;
+	unsigned char *out;
+	size_t *comp_len;
+	void *lzo_wrkmem;
+	z_stream deflate;
+	z_stream inflate;
+	struct xz_dec *xz;
+};
+
+#define CORPUS_STREAM(name, fmt)					\
+	extern const unsigned char corpus_##name##_##fmt[];		\
+	extern const unsigned char corpus_##name##_##fmt##_end[]
+
+CORPUS_STREAM(text, xz);
+CORPUS_STREAM(records, xz);
+CORPUS_STREAM(zero, xz);
+CORPUS_STREAM(random, xz);
+CORPUS_STREAM(text, lzma);
+CORPUS_STREAM(records, lzma);
+CORPUS_STREAM(zero, lzma);
+CORPUS_STREAM(random, lzma);
+
+struct packed_corpus {
+	const unsigned char *start;
+	const unsigned char *end;
+};
+
+#define PACKED_CORPORA(fmt) {						\
+	[CORPUS_TEXT]	 = { corpus_text_##fmt, corpus_text_##fmt##_end },	\
+	[CORPUS_RECORDS] = { corpus_records_##fmt, corpus_records_##fmt##_end }, \
+	[CORPUS_ZERO]	 = { corpus_zero_##fmt, corpus_zero_##fmt##_end },	\
+	[CORPUS_RANDOM]	 = { corpus_random_##fmt, corpus_random_##fmt##_end }, \
+}
+
+static const struct packed_corpus packed_xz[NR_CORPUS] __initconst =
+	PACKED_CORPORA(xz);
+static const struct packed_corpus packed_lzma[NR_CORPUS] __initconst =
+	PACKED_CORPORA(lzma);
+
+struct compressor {
+	const char *name;
+	int (*compress)(struct compress_test *t, const unsigned char *src,
+			size_t src_len, unsigned char *dst, size_t *dst_len);
+	int (*decompress)(struct compress_test *t, const unsigned char *src,
+			  size_t src_len, unsigned char *dst, size_t *dst_len);
+	/* build-time compressed corpora, for decompress-only formats */
+	const struct packed_corpus *packed;
+};
+
+static int __init lzo_compress(struct compress_test *t,
+			       const unsigned char *src, size_t src_len,
+			       unsigned char *dst, size_t *dst_len)
+{
+	int ret = lzo1x_1_compress(src, src_len, dst, dst_len, t->lzo_wrkmem);
+
+	return ret == LZO_E_OK ? 0 : -EINVAL;
+}
+
+static int __init lzo_decompress(struct compress_test *t,
+				 const unsigned char *src, size_t src_len,
+				 unsigned char *dst, size_t *dst_len)
+{
+	int ret = lzo1x_decompress_safe(src, src_len, dst, dst_len);
+
+	return ret == LZO_E_OK ? 0 : -EINVAL;
+}
+
+static int __init deflate_compress(struct compress_test *t,
+				   const unsigned char *src, size_t src_len,
+				   unsigned char *dst, size_t *dst_len)
+{
+	z_stream *s = &t->deflate;
+
+	if (zlib_deflateReset(s) != Z_OK)
+		return -EINVAL;
+
+	s->next_in = src;
+	s->avail_in = src_len;
+	s->next_out = dst;
+	s->avail_out = *dst_len;
+	if (zlib_deflate(s, Z_FINISH) != Z_STREAM_END)
+		return -EINVAL;
+
+	*dst_len = s->total_out;
+	return 0;
+}
+
+static int __init deflate_decompress(struct compress_test *t,
+				     const unsigned char *src, size_t src_len,
+				     unsigned char *dst, size_t *dst_len)
+{
+	z_stream *s = &t->inflate;
+
+	if (zlib_inflateReset(s) != Z_OK)
+		return -EINVAL;
+
+	s->next_in = src;
+	s->avail_in = src_len;
+	s->next_out = dst;
+	s->avail_out = *dst_len;
+	if (zlib_inflate(s, Z_FINISH) != Z_STREAM_END)
+		return -EINVAL;
+
+	*dst_len = s->total_out;
+	return 0;
+}
+
+static int __init xz_decompress(struct compress_test *t,
+				const unsigned char *src, size_t src_len,
+				unsigned char *dst, size_t *dst_len)
+{
+	struct xz_buf b = {
+		.in		= src,
+		.in_size	= src_len,
+		.out		= dst,
+		.out_size	= *dst_len,
+	};
+
+	xz_dec_reset(t->xz);
+	if (xz_dec_run(t->xz, &b) != XZ_STREAM_END)
+		return -EINVAL;
+
+	*dst_len = b.out_pos;
+	return 0;
+}
+
+static int lzma_failed __initdata;
+
+static void __init lzma_error(char *msg)
+{
+	pr_err("compress: lzma: %s\n", msg);
+	lzma_failed = 1;
+}
+
+static int __init lzma_decompress(struct compress_test *t,
+				  const unsigned char *src, size_t src_len,
+				  unsigned char *dst, size_t *dst_len)
+{
+	int pos;
+
+	/*
+	 * The .lzma streams carry no size and unlzma() can't bound its
+	 * output, so this relies on the packed corpora being CORPUS_SIZE.
+	 */
+	lzma_failed = 0;
+	if (test_unlzma((unsigned char *)src, src_len, NULL, NULL, dst, &pos,
+			lzma_error) || lzma_failed)
+		return -EINVAL;
+
+	*dst_len = CORPUS_SIZE;
+	return 0;
+}
+
+static const struct compressor compressors[] __initconst = {
+	{ "lzo",	lzo_compress,		lzo_decompress },
+	{ "deflate",	deflate_compress,	deflate_decompress },
+	{ "xz",		NULL,			xz_decompress,	packed_xz },
+	{ "lzma",	NULL,			lzma_decompress, packed_lzma },
+};
+
+static u64 __init compress_mbps(size_t bytes, ktime_t start)
+{
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (ns <= 0)
+		return 0;
+	return div64_u64((u64)bytes * iterations * 1000, ns);
+}
+
+/*
+ * Compress (or, for decompress-only formats, copy in the packed stream)
+ * every block of the corpus and check that each decompresses back.
+ */
+static int __init compress_verify(struct compress_test *t,
+				  const struct compressor *c, int corpus,
+				  size_t blksz)
+{
+	size_t slot = lzo1x_worst_compress(blksz);
+	unsigned int nr = CORPUS_SIZE / blksz, i;
+	int err;
+
+	for (i = 0; i < nr; i++) {
+		unsigned char *comp = t->comp + i * slot;
+		size_t out_len = blksz;
+
+		if (c->compress) {
+			t->comp_len[i] = slot;
+			err = c->compress(t, t->src + i * blksz, blksz, comp,
+					  &t->comp_len[i]);
+			if (err) {
+				pr_err("compress: %s %s/%zu block %u: "
+				       "compression failed\n", c->name,
+				       corpus_names[corpus], blksz, i);
+				return err;
+			}
+		} else {
+			const struct packed_corpus *p = &c->packed[corpus];
+
+			t->comp_len[i] = p->end - p->start;
+			memcpy(comp, p->start, t->comp_len[i]);
+		}
+
+		err = c->decompress(t, comp, t->comp_len[i], t->out, &out_len);
+		if (err || out_len != blksz ||
+		    memcmp(t->out, t->src + i * blksz, blksz)) {
+			pr_err("compress: %s %s/%zu block %u: decompression "
+			       "failed (%d, %zu bytes)\n", c->name,
+			       corpus_names[corpus], blksz, i, err, out_len);
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+static void __init compress_bench(struct compress_test *t,
+				  const struct compressor *c, int corpus,
+				  size_t blksz)
+{
+	size_t slot = lzo1x_worst_compress(blksz), total = 0;
+	unsigned int nr = CORPUS_SIZE / blksz, i, n;
+	u64 comp_mbps = 0, decomp_mbps;
+	ktime_t start;
+
+	for (i = 0; i < nr; i++)
+		total += t->comp_len[i];
+
+	if (c->compress) {
+		start = ktime_get();
+		for (n = 0; n < iterations; n++) {
+			for (i = 0; i < nr; i++) {
+				size_t len = slot;
+
+				c->compress(t, t->src + i * blksz, blksz,
+					    t->out, &len);
+			}
+			cond_resched();
+		}
+		comp_mbps = compress_mbps(CORPUS_SIZE, start);
+	}
+
+	start = ktime_get();
+	for (n = 0; n < iterations; n++) {
+		for (i = 0; i < nr; i++) {
+			size_t len = blksz;
+
+			c->decompress(t, t->comp + i * slot, t->comp_len[i],
+				      t->out, &len);
+		}
+		cond_resched();
+	}
+	decomp_mbps = compress_mbps(CORPUS_SIZE, start);
+
+	if (c->compress)
+		pr_info("compress: %-7s %-7s %6zu byte blocks: ratio %3zu%%, "
+			"compress %4llu MB/s, decompress %4llu MB/s\n",
+			c->name, corpus_names[corpus], blksz,
+			total * 100 / CORPUS_SIZE, comp_mbps, decomp_mbps);
+	else
+		pr_info("compress: %-7s %-7s %6zu byte blocks: ratio %3zu%%, "
+			"compress    - MB/s, decompress %4llu MB/s\n",
+			c->name, corpus_names[corpus], blksz,
+			total * 100 / CORPUS_SIZE, decomp_mbps);
+}
+
+static int __init test_compress_init(void)
+{
+	static const size_t blksz[] __initconst = { PAGE_SIZE, CORPUS_SIZE };
+	size_t slots = (CORPUS_SIZE / PAGE_SIZE) * lzo1x_worst_compress(PAGE_SIZE);
+	struct compress_test t;
+	int corpus, i, j, err = -ENOMEM;
+
+	memset(&t, 0, sizeof(t));
+	t.src = vmalloc(CORPUS_SIZE);
+	t.comp = vmalloc(slots);
+	t.out = vmalloc(lzo1x_worst_compress(CORPUS_SIZE));
+	t.comp_len = vmalloc(CORPUS_SIZE / PAGE_SIZE * sizeof(size_t));
+	t.lzo_wrkmem = vmalloc(LZO1X_MEM_COMPRESS);
+	t.deflate.workspace = vmalloc(zlib_deflate_workspacesize(MAX_WBITS,
+								 MAX_MEM_LEVEL));
+	t.inflate.workspace = vmalloc(zlib_inflate_workspacesize());
+	t.xz = xz_dec_init(XZ_SINGLE, 0);
+	if (!t.src || !t.comp || !t.out || !t.comp_len || !t.lzo_wrkmem ||
+	    !t.deflate.workspace || !t.inflate.workspace || !t.xz)
+		goto out;
+
+	err = -EINVAL;
+	if (zlib_deflateInit(&t.deflate, deflate_level) != Z_OK)
+		goto out;
+	if (zlib_inflateInit(&t.inflate) != Z_OK)
+		goto out_deflate;
+
+	err = 0;
+	for (corpus = 0; corpus < NR_CORPUS && !err; corpus++) {
+		fill_corpus(t.src, CORPUS_SIZE, corpus);
+		for (i = 0; i < ARRAY_SIZE(compressors) && !err; i++) {
+			const struct compressor *c = &compressors[i];
+
+			for (j = 0; j < ARRAY_SIZE(blksz) && !err; j++) {
+				/* packed streams cover the whole corpus */
+				if (!c->compress && blksz[j] != CORPUS_SIZE)
+					continue;
+				err = compress_verify(&t, c, corpus, blksz[j]);
+				if (!err)
+					compress_bench(&t, c, corpus, blksz[j]);
+			}
+		}
+	}
+	if (!err)
+		pr_info("compress: all tests passed\n");
+
+	zlib_inflateEnd(&t.inflate);
+out_deflate:
+	zlib_deflateEnd(&t.deflate);
+out:
+	if (t.xz)
+		xz_dec_end(t.xz);
+	vfree(t.inflate.workspace);
+	vfree(t.deflate.workspace);
+	vfree(t.lzo_wrkmem);
+	vfree(t.comp_len);
+	vfree(t.out);
+	vfree(t.comp);
+	vfree(t.src);
+
+	/*
+	 * The built-in corpora and their xz and lzma streams weigh several
+	 * hundred KiB; failing the load with -EAGAIN frees them right away.
+	 */
+	return err ? err : -EAGAIN;
+}
+module_init(test_compress_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Compression benchmark for lzo, deflate, xz and lzma");
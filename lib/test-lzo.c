@@ -0,0 +1,217 @@
+/*
+ * Self-test and benchmark for the LZO1X-1 compressor and decompressor.
+ *
+ * The kernel's LZO1X code is checked against a reference copy built from
+ * the same source the way the boot decompressor builds it (with STATIC
+ * defined), which never takes the word-at-a-time fast paths.  Compressed
+ * streams must be bit-for-bit identical and every round trip must restore
+ * the input; throughput of both versions is then reported in MB/s.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/lzo.h>
+
+#define STATIC
+#define lzo1x_1_compress	lzo1x_1_compress_ref
+#define lzo1x_decompress_safe	lzo1x_decompress_safe_ref
+#include "lzo/lzo1x_compress.c"
+#include "lzo/lzo1x_decompress.c"
+#undef lzo1x_1_compress
+#undef lzo1x_decompress_safe
+#undef STATIC
+
+#include "compress_corpus.h"
+
+static unsigned int iterations = 32;
+module_param(iterations, uint, 0);
+MODULE_PARM_DESC(iterations, "Number of passes over the corpus per measurement");
+
+struct lzo_impl {
+	const char *name;
+	int (*compress)(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len, void *wrkmem);
+	int (*decompress)(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len);
+};
+
+static const struct lzo_impl lzo_impls[] = {
+	{
+		.name		= "ref",
+		.compress	= lzo1x_1_compress_ref,
+		.decompress	= lzo1x_decompress_safe_ref,
+	}, {
+#ifdef CONFIG_LZO_FAST_UNALIGNED
+		.name		= "fast",
+#else
+		.name		= "kernel",
+#endif
+		.compress	= lzo1x_1_compress,
+		.decompress	= lzo1x_decompress_safe,
+	},
+};
+
+struct lzo_test_buf {
+	unsigned char *src;
+	unsigned char *ref;
+	unsigned char *comp;
+	unsigned char *out;
+	size_t *comp_len;
+	void *wrkmem;
+};
+
+/* Compress every block with both implementations and check they agree */
+static int __init lzo_verify(struct lzo_test_buf *b, const char *corpus,
+			     size_t blksz)
+{
+	size_t slot = lzo1x_worst_compress(blksz);
+	unsigned int nr = CORPUS_SIZE / blksz, i, j;
+
+	for (i = 0; i < nr; i++) {
+		const unsigned char *src = b->src + i * blksz;
+		unsigned char *comp = b->comp + i * slot;
+		size_t ref_len = slot, out_len;
+
+		lzo1x_1_compress_ref(src, blksz, b->ref, &ref_len, b->wrkmem);
+		b->comp_len[i] = slot;
+		lzo1x_1_compress(src, blksz, comp, &b->comp_len[i], b->wrkmem);
+
+		if (b->comp_len[i] != ref_len ||
+		    memcmp(comp, b->ref, ref_len)) {
+			pr_err("lzo: %s/%zu block %u: compressed stream differs "
+			       "from reference (%zu vs %zu bytes)\n",
+			       corpus, blksz, i, b->comp_len[i], ref_len);
+			return -EINVAL;
+		}
+
+		for (j = 0; j < ARRAY_SIZE(lzo_impls); j++) {
+			int ret;
+
+			out_len = blksz;
+			ret = lzo_impls[j].decompress(comp, b->comp_len[i],
+						      b->out, &out_len);
+			if (ret != LZO_E_OK || out_len != blksz ||
+			    memcmp(b->out, src, blksz)) {
+				pr_err("lzo: %s/%zu block %u: %s decompression "
+				       "failed (%d, %zu bytes)\n", corpus,
+				       blksz, i, lzo_impls[j].name, ret,
+				       out_len);
+				return -EINVAL;
+			}
+		}
+	}
+	return 0;
+}
+
+static u64 __init lzo_mbps(size_t bytes, ktime_t start)
+{
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (ns <= 0)
+		return 0;
+	return div64_u64((u64)bytes * iterations * 1000, ns);
+}
+
+static void __init lzo_bench(struct lzo_test_buf *b, const char *corpus,
+			     size_t blksz)
+{
+	size_t slot = lzo1x_worst_compress(blksz), total = 0;
+	unsigned int nr = CORPUS_SIZE / blksz, i, j, n;
+
+	for (i = 0; i < nr; i++)
+		total += b->comp_len[i];
+
+	for (j = 0; j < ARRAY_SIZE(lzo_impls); j++) {
+		const struct lzo_impl *impl = &lzo_impls[j];
+		u64 comp_mbps, decomp_mbps;
+		ktime_t start;
+
+		start = ktime_get();
+		for (n = 0; n < iterations; n++) {
+			for (i = 0; i < nr; i++) {
+				size_t len = slot;
+
+				impl->compress(b->src + i * blksz, blksz,
+					       b->ref, &len, b->wrkmem);
+			}
+			cond_resched();
+		}
+		comp_mbps = lzo_mbps(CORPUS_SIZE, start);
+
+		start = ktime_get();
+		for (n = 0; n < iterations; n++) {
+			for (i = 0; i < nr; i++) {
+				size_t len = blksz;
+
+				impl->decompress(b->comp + i * slot,
+						 b->comp_len[i], b->out, &len);
+			}
+			cond_resched();
+		}
+		decomp_mbps = lzo_mbps(CORPUS_SIZE, start);
+
+		pr_info("lzo: %-7s %-6s %6zu byte blocks: ratio %3zu%%, "
+			"compress %4llu MB/s, decompress %4llu MB/s\n",
+			corpus, impl->name, blksz, total * 100 / CORPUS_SIZE,
+			comp_mbps, decomp_mbps);
+	}
+}
+
+static int __init test_lzo_init(void)
+{
+	static const size_t blksz[] __initconst = { PAGE_SIZE, CORPUS_SIZE };
+	size_t slots = (CORPUS_SIZE / PAGE_SIZE) * lzo1x_worst_compress(PAGE_SIZE);
+	struct lzo_test_buf b;
+	int corpus, i, err = -ENOMEM;
+
+	b.src = vmalloc(CORPUS_SIZE);
+	b.ref = vmalloc(lzo1x_worst_compress(CORPUS_SIZE));
+	b.comp = vmalloc(slots);
+	b.out = vmalloc(CORPUS_SIZE);
+	b.comp_len = vmalloc(CORPUS_SIZE / PAGE_SIZE * sizeof(size_t));
+	b.wrkmem = vmalloc(LZO1X_MEM_COMPRESS);
+	if (!b.src || !b.ref || !b.comp || !b.out || !b.comp_len || !b.wrkmem)
+		goto out;
+
+	err = 0;
+	for (corpus = 0; corpus < NR_CORPUS && !err; corpus++) {
+		fill_corpus(b.src, CORPUS_SIZE, corpus);
+		for (i = 0; i < ARRAY_SIZE(blksz) && !err; i++) {
+			err = lzo_verify(&b, corpus_names[corpus], blksz[i]);
+			if (!err)
+				lzo_bench(&b, corpus_names[corpus], blksz[i]);
+		}
+	}
+	if (!err)
+		pr_info("lzo: all tests passed\n");
+
+out:
+	vfree(b.wrkmem);
+	vfree(b.comp_len);
+	vfree(b.out);
+	vfree(b.comp);
+	vfree(b.ref);
+	vfree(b.src);
+
+	/*
+	 * -EINVAL means the fast paths disagree with the reference code.
+	 * Even when all is well there is nothing to keep loaded: the next
+	 * run, after rebuilding with other fast paths, is another insmod.
+	 */
+	return err ? err : -EAGAIN;
+}
+module_init(test_lzo_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZO1X self-test and benchmark");
@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -42,6 +44,7 @@ struct compact_control {
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
+	bool kcompactd;			/* Background compaction by kcompactd */
 };
 
 static unsigned long release_freepages(struct list_head *freelist)
@@ -449,6 +452,20 @@ static int compact_finished(struct zone *zone,
 	if (cc->order == -1)
 		return COMPACT_CONTINUE;
 
+	/*
+	 * kcompactd is not after a single page: it keeps going until
+	 * fragmentation for its order is well below the wakeup threshold,
+	 * and backs off as soon as the thread is asked to stop.
+	 */
+	if (cc->kcompactd) {
+		if (kthread_should_stop())
+			return COMPACT_PARTIAL;
+		if (unusable_index(zone, cc->order) <=
+					sysctl_kcompactd_threshold / 2)
+			return COMPACT_PARTIAL;
+		return COMPACT_CONTINUE;
+	}
+
 	/* Compaction run is not finished if the watermark is not met */
 	watermark = low_wmark_pages(zone);
 	watermark += (1 << cc->order);
@@ -527,6 +544,10 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 	ret = compaction_suitable(zone, cc->order);
 	switch (ret) {
 	case COMPACT_PARTIAL:
+		/* kcompactd wants more than one free page of the order */
+		if (cc->kcompactd)
+			break;
+		/* fall through */
 	case COMPACT_SKIPPED:
 		/* Compaction is likely to fail */
 		return ret;
@@ -703,6 +724,219 @@ static int compact_nodes(void)
 	return COMPACT_COMPLETE;
 }
 
+/*
+ * Background compaction
+ *
+ * Each node has a kcompactd thread that kswapd wakes up when it is done
+ * reclaiming and about to go to sleep, if the free memory of one of the
+ * node's zones is too fragmented to serve allocations of the order in
+ * vm.kcompactd_order.  Fragmentation is measured with the unusable free
+ * space index (see /sys/kernel/debug/extfrag/unusable_index): the share
+ * of free memory, in per mille, that sits in blocks smaller than the
+ * order.  kcompactd then compacts the zone asynchronously until that
+ * index drops below half of vm.kcompactd_threshold, so that high-order
+ * allocations find their pages free instead of stalling in direct
+ * compaction.
+ */
+
+/* Order kcompactd keeps available, 0 disables background compaction */
+int sysctl_kcompactd_order = PAGE_ALLOC_COSTLY_ORDER;
+
+/* Unusable free space index (0-1000) above which kcompactd is woken */
+int sysctl_kcompactd_threshold = 500;
+
+static bool kcompactd_zone_suitable(struct zone *zone, int order)
+{
+	unsigned long watermark;
+
+	/* Enough free pages to migrate into, as in compaction_suitable() */
+	watermark = low_wmark_pages(zone) + (2UL << order);
+	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		return false;
+
+	return unusable_index(zone, order) > sysctl_kcompactd_threshold;
+}
+
+static bool kcompactd_node_suitable(pg_data_t *pgdat, int order,
+				    int classzone_idx)
+{
+	int zoneid;
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+
+		if (kcompactd_zone_suitable(zone, order))
+			return true;
+	}
+
+	return false;
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int order = pgdat->kcompactd_max_order;
+	int classzone_idx = pgdat->kcompactd_classzone_idx;
+	int zoneid;
+
+	pgdat->kcompactd_max_order = 0;
+	pgdat->kcompactd_classzone_idx = 0;
+
+	count_vm_event(KCOMPACTD_WAKE);
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = order,
+			.migratetype = MIGRATE_MOVABLE,
+			.zone = zone,
+			.sync = false,
+			.kcompactd = true,
+		};
+
+		if (!populated_zone(zone))
+			continue;
+
+		if (kthread_should_stop())
+			return;
+
+		if (compaction_deferred(zone) ||
+		    !kcompactd_zone_suitable(zone, order))
+			continue;
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		compact_zone(zone, &cc);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		if (unusable_index(zone, order) <= sysctl_kcompactd_threshold) {
+			zone->compact_considered = 0;
+			zone->compact_defer_shift = 0;
+			count_vm_event(KCOMPACTD_SUCCESS);
+		} else {
+			/* Don't keep rescanning a zone that won't compact */
+			defer_compaction(zone);
+			count_vm_event(KCOMPACTD_FAIL);
+		}
+	}
+}
+
+/**
+ * wakeup_kcompactd - kick background compaction on a node
+ * @pgdat: node kswapd just balanced
+ * @order: order kswapd was reclaiming for
+ * @classzone_idx: highest zone kswapd was reclaiming for
+ *
+ * Called by kswapd before it goes to sleep.  Wakes the node's kcompactd
+ * if free memory is too fragmented for vm.kcompactd_order, or @order if
+ * that is larger.
+ */
+void wakeup_kcompactd(pg_data_t *pgdat, int order, int classzone_idx)
+{
+	if (!sysctl_kcompactd_order || !pgdat->kcompactd)
+		return;
+
+	order = max(order, sysctl_kcompactd_order);
+	if (order >= MAX_ORDER)
+		order = MAX_ORDER - 1;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	if (!kcompactd_node_suitable(pgdat, order, classzone_idx))
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	if (pgdat->kcompactd_classzone_idx < classzone_idx)
+		pgdat->kcompactd_classzone_idx = classzone_idx;
+
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+static bool kcompactd_work_requested(pg_data_t *pgdat)
+{
+	return kthread_should_stop() || pgdat->kcompactd_max_order > 0;
+}
+
+/*
+ * The background compaction daemon, started as a kernel thread
+ * from the init process.
+ */
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+
+	pgdat->kcompactd_max_order = 0;
+	pgdat->kcompactd_classzone_idx = 0;
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(pgdat->kcompactd_wait,
+				     kcompactd_work_requested(pgdat));
+		if (pgdat->kcompactd_max_order > 0)
+			kcompactd_do_work(pgdat);
+	}
+
+	return 0;
+}
+
+/*
+ * This kcompactd start function will be called by init and node-hot-add.
+ * On node-hot-add, kcompactd will be moved to proper cpus if cpus are
+ * hot-added.
+ */
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		ret = PTR_ERR(pgdat->kcompactd);
+		pgdat->kcompactd = NULL;
+	}
+	return ret;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined.
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	return 0;
+}
+module_init(kcompactd_init)
+
 /* The written value is actually unused, all memory is compacted */
 int sysctl_compact_memory;
 
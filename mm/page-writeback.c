@@ -43,18 +43,14 @@
 static long ratelimit_pages = 32;
 
 /*
- * When balance_dirty_pages decides that the caller needs to perform some
- * non-background writeback, this is how many pages it will attempt to write.
- * It should be somewhat larger than dirtied pages to ensure that reasonably
- * large amounts of I/O are submitted.
+ * Sleep at most 200ms at a time in balance_dirty_pages().
  */
-static inline long sync_writeback_pages(unsigned long dirtied)
-{
-	if (dirtied < ratelimit_pages)
-		dirtied = ratelimit_pages;
+#define MAX_PAUSE		max(HZ/5, 1)
 
-	return dirtied + dirtied / 2;
-}
+/*
+ * Estimate write bandwidth at 200ms intervals.
+ */
+#define BANDWIDTH_INTERVAL	max(HZ/5, 1)
 
 /* The following parameters are exported via /proc/sys/vm */
 
@@ -96,6 +92,12 @@ unsigned int dirty_writeback_interval = 5 * 100; /* centiseconds */
  */
 unsigned int dirty_expire_interval = 30 * 100; /* centiseconds */
 
+/*
+ * Limit each bdi's dirty pages to what it can write back in this time,
+ * judged by its measured write bandwidth.  Zero disables the limit.
+ */
+unsigned int vm_dirty_latency = 1000; /* milliseconds */
+
 /*
  * Flag that makes the machine dump writes/reads and block dirtyings.
  */
@@ -219,6 +221,7 @@ int dirty_bytes_handler(struct ctl_table *table, int write,
  */
 static inline void __bdi_writeout_inc(struct backing_dev_info *bdi)
 {
+	__inc_bdi_stat(bdi, BDI_WRITTEN);
 	__prop_inc_percpu_max(&vm_completions, &bdi->completions,
 			      bdi->max_prop_frac);
 }
@@ -468,50 +471,155 @@ unsigned long bdi_dirty_limit(struct backing_dev_info *bdi, unsigned long dirty)
 	return bdi_dirty;
 }
 
+/*
+ * bdi_latency_limit - dirty pages @bdi can write back in vm_dirty_latency
+ *
+ * Slow and fast devices get the same share of the global limit when they
+ * write at the same time, so a slow device can end up holding many seconds
+ * worth of dirty data that a sync or a page reclaimer then has to wait for.
+ * Cap each bdi at its estimated write bandwidth times vm_dirty_latency.
+ * The cap does not go below 1/16 of the global limit @dirty, to keep enough
+ * dirty pages around for the device to stay busy (and the estimate sane).
+ */
+unsigned long bdi_latency_limit(struct backing_dev_info *bdi,
+				unsigned long dirty)
+{
+	u64 limit;
+
+	if (!vm_dirty_latency || !bdi_cap_writeback_dirty(bdi))
+		return ULONG_MAX;
+
+	limit = (u64)bdi->avg_write_bandwidth * vm_dirty_latency;
+	do_div(limit, MSEC_PER_SEC);
+
+	return max_t(unsigned long, min_t(u64, limit, dirty), dirty / 16);
+}
+
+static void bdi_update_write_bandwidth(struct backing_dev_info *bdi,
+				       unsigned long elapsed,
+				       unsigned long written)
+{
+	const unsigned long period = roundup_pow_of_two(3 * HZ);
+	unsigned long avg = bdi->avg_write_bandwidth;
+	unsigned long old = bdi->write_bandwidth;
+	u64 bw;
+
+	/*
+	 * bw = written * HZ / elapsed
+	 *
+	 *                   bw * elapsed + write_bandwidth * (period - elapsed)
+	 * write_bandwidth = ---------------------------------------------------
+	 *                                          period
+	 */
+	bw = written - bdi->written_stamp;
+	bw *= HZ;
+	if (unlikely(elapsed > period)) {
+		do_div(bw, elapsed);
+		avg = bw;
+		goto out;
+	}
+	bw += (u64)bdi->write_bandwidth * (period - elapsed);
+	bw >>= ilog2(period);
+
+	/*
+	 * one more level of smoothing, for filtering out sudden spikes
+	 */
+	if (avg > old && old >= (unsigned long)bw)
+		avg -= (avg - old) >> 3;
+
+	if (avg < old && old <= (unsigned long)bw)
+		avg += (old - avg) >> 3;
+
+out:
+	bdi->write_bandwidth = bw;
+	bdi->avg_write_bandwidth = max(avg, 1UL);
+}
+
+/**
+ * bdi_update_bandwidth - refresh the write bandwidth estimate of @bdi
+ * @bdi: the backing device
+ * @start_time: when the caller started writing to, or dirtying pages of, @bdi
+ *
+ * Called at least every BANDWIDTH_INTERVAL while the flusher or a throttled
+ * dirtier is busy on @bdi.  Periods that began before @start_time and are
+ * longer than a second were (at least partly) idle and are not sampled.
+ */
+void bdi_update_bandwidth(struct backing_dev_info *bdi,
+			  unsigned long start_time)
+{
+	static DEFINE_SPINLOCK(bw_lock);
+	unsigned long now = jiffies;
+	unsigned long elapsed = now - bdi->bw_time_stamp;
+	unsigned long written;
+
+	if (elapsed < BANDWIDTH_INTERVAL || !spin_trylock(&bw_lock))
+		return;
+
+	/* recheck, someone else may have got here first */
+	elapsed = now - bdi->bw_time_stamp;
+	if (elapsed < BANDWIDTH_INTERVAL)
+		goto unlock;
+
+	written = percpu_counter_read(&bdi->bdi_stat[BDI_WRITTEN]);
+
+	if (elapsed > HZ && time_before(bdi->bw_time_stamp, start_time))
+		goto snapshot;
+
+	bdi_update_write_bandwidth(bdi, elapsed, written);
+
+snapshot:
+	bdi->written_stamp = written;
+	bdi->bw_time_stamp = now;
+unlock:
+	spin_unlock(&bw_lock);
+}
+
 /*
  * balance_dirty_pages() must be called by processes which are generating dirty
- * data.  It looks at the number of dirty pages in the machine and will force
- * the caller to perform writeback if the system is over `vm_dirty_ratio'.
- * If we're over `background_thresh' then the writeback threads are woken to
- * perform some writeout.
+ * data.  It looks at the number of dirty pages in the machine and on the bdi,
+ * and once the bdi gets close to its limit it puts the caller to sleep long
+ * enough that pages are not dirtied faster than the bdi writes them back.
+ * The writing itself is left to the flusher threads, which are kicked when
+ * we're over `background_thresh' or over half the bdi's latency limit.
  */
 static void balance_dirty_pages(struct address_space *mapping,
-				unsigned long write_chunk)
+				unsigned long pages_dirtied)
 {
-	long nr_reclaimable, bdi_nr_reclaimable;
+	long nr_reclaimable, bdi_nr_reclaimable = 0;
 	long nr_writeback, bdi_nr_writeback;
+	unsigned long nr_dirty, bdi_dirty;
 	unsigned long background_thresh;
 	unsigned long dirty_thresh;
-	unsigned long bdi_thresh;
-	unsigned long pages_written = 0;
-	unsigned long pause = 1;
+	unsigned long latency_thresh;
+	unsigned long bdi_thresh, bdi_setpoint;
+	unsigned long start_time = jiffies;
+	unsigned long rate;
+	long pause;
+	bool throttled = false;
 	bool dirty_exceeded = false;
 	struct backing_dev_info *bdi = mapping->backing_dev_info;
 
 	for (;;) {
-		struct writeback_control wbc = {
-			.sync_mode	= WB_SYNC_NONE,
-			.older_than_this = NULL,
-			.nr_to_write	= write_chunk,
-			.range_cyclic	= 1,
-		};
-
 		nr_reclaimable = global_page_state(NR_FILE_DIRTY) +
 					global_page_state(NR_UNSTABLE_NFS);
 		nr_writeback = global_page_state(NR_WRITEBACK);
+		nr_dirty = nr_reclaimable + nr_writeback;
 
 		global_dirty_limits(&background_thresh, &dirty_thresh);
+		latency_thresh = bdi_latency_limit(bdi, dirty_thresh);
 
 		/*
-		 * Throttle it only when the background writeback cannot
-		 * catch-up. This avoids (excessively) small writeouts
-		 * when the bdi limits are ramping up.
+		 * The proportional bdi limit only applies once the background
+		 * writeback cannot catch-up. This avoids (excessively) small
+		 * writeouts when the bdi limits are ramping up.  The latency
+		 * limit is a property of the device and always applies.
 		 */
-		if (nr_reclaimable + nr_writeback <=
-				(background_thresh + dirty_thresh) / 2)
+		bdi_thresh = latency_thresh;
+		if (nr_dirty > (background_thresh + dirty_thresh) / 2)
+			bdi_thresh = min(bdi_thresh,
+					 bdi_dirty_limit(bdi, dirty_thresh));
+		else if (bdi_thresh == ULONG_MAX)
 			break;
-
-		bdi_thresh = bdi_dirty_limit(bdi, dirty_thresh);
 		bdi_thresh = task_dirty_limit(current, bdi_thresh);
 
 		/*
@@ -531,51 +639,60 @@ static void balance_dirty_pages(struct address_space *mapping,
 			bdi_nr_reclaimable = bdi_stat(bdi, BDI_RECLAIMABLE);
 			bdi_nr_writeback = bdi_stat(bdi, BDI_WRITEBACK);
 		}
+		bdi_dirty = bdi_nr_reclaimable + bdi_nr_writeback;
 
 		/*
 		 * The bdi thresh is somehow "soft" limit derived from the
 		 * global "hard" limit. The former helps to prevent heavy IO
 		 * bdi or process from holding back light ones; The latter is
 		 * the last resort safeguard.
+		 *
+		 * Throttling starts at 3/4 of the bdi thresh, where the
+		 * dirtier is held to the bdi's write bandwidth, scaled down
+		 * linearly to nothing at the thresh itself.  The dirty count
+		 * then settles where the two rates meet rather than bouncing
+		 * off the limit.
 		 */
-		dirty_exceeded =
-			(bdi_nr_reclaimable + bdi_nr_writeback > bdi_thresh)
-			|| (nr_reclaimable + nr_writeback > dirty_thresh);
+		bdi_setpoint = bdi_thresh - bdi_thresh / 4;
+		dirty_exceeded = (bdi_dirty > bdi_thresh) ||
+				 (nr_dirty > dirty_thresh);
 
-		if (!dirty_exceeded)
+		if (!dirty_exceeded && bdi_dirty <= bdi_setpoint)
 			break;
 
-		if (!bdi->dirty_exceeded)
+		if (dirty_exceeded && !bdi->dirty_exceeded)
 			bdi->dirty_exceeded = 1;
 
-		/* Note: nr_reclaimable denotes nr_dirty + nr_unstable.
-		 * Unstable writes are a feature of certain networked
-		 * filesystems (i.e. NFS) in which data may have been
-		 * written to the server's write cache, but has not yet
-		 * been flushed to permanent storage.
-		 * Only move pages to writeback if this bdi is over its
-		 * threshold otherwise wait until the disk writes catch
-		 * up.
-		 */
-		trace_wbc_balance_dirty_start(&wbc, bdi);
-		if (bdi_nr_reclaimable > bdi_thresh) {
-			writeback_inodes_wb(&bdi->wb, &wbc);
-			pages_written += write_chunk - wbc.nr_to_write;
-			trace_wbc_balance_dirty_written(&wbc, bdi);
-			if (pages_written >= write_chunk)
-				break;		/* We've done our duty */
+		if (!writeback_in_progress(bdi))
+			bdi_start_background_writeback(bdi);
+
+		bdi_update_bandwidth(bdi, start_time);
+
+		if (dirty_exceeded || bdi_dirty >= bdi_thresh) {
+			pause = MAX_PAUSE;
+		} else {
+			u64 r = (u64)bdi->avg_write_bandwidth *
+					(bdi_thresh - bdi_dirty);
+
+			do_div(r, bdi_thresh - bdi_setpoint);
+			rate = r;
+			pause = rate ? DIV_ROUND_UP(pages_dirtied * HZ, rate) :
+				       MAX_PAUSE;
+			pause = clamp_t(long, pause, 1, MAX_PAUSE);
 		}
-		trace_wbc_balance_dirty_wait(&wbc, bdi);
+
+		trace_balance_dirty_pages(bdi, bdi_thresh, bdi_dirty,
+					  pages_dirtied, pause);
 		__set_current_state(TASK_UNINTERRUPTIBLE);
 		io_schedule_timeout(pause);
+		throttled = true;
 
 		/*
-		 * Increase the delay for each loop, up to our previous
-		 * default of taking a 100ms nap.
+		 * Below the limit a single pause paces the caller.  Above
+		 * it, keep waiting for the flusher to bring us back under.
 		 */
-		pause <<= 1;
-		if (pause > HZ / 10)
-			pause = HZ / 10;
+		if (!dirty_exceeded || fatal_signal_pending(current))
+			break;
 	}
 
 	if (!dirty_exceeded && bdi->dirty_exceeded)
@@ -590,10 +707,13 @@ static void balance_dirty_pages(struct address_space *mapping,
 	 * to the lower threshold.  So slow writers cause minimal disk activity.
 	 *
 	 * In normal mode, we start background writeout at the lower
-	 * background_thresh, to keep the amount of dirty memory low.
+	 * background_thresh, to keep the amount of dirty memory low, or once
+	 * the bdi holds half of what it can write back within the latency
+	 * limit.
 	 */
-	if ((laptop_mode && pages_written) ||
-	    (!laptop_mode && (nr_reclaimable > background_thresh)))
+	if ((laptop_mode && throttled) ||
+	    (!laptop_mode && (nr_reclaimable > background_thresh ||
+			      bdi_nr_reclaimable > latency_thresh / 2)))
 		bdi_start_background_writeback(bdi);
 }
 
@@ -641,7 +761,7 @@ void balance_dirty_pages_ratelimited_nr(struct address_space *mapping,
 	p =  &__get_cpu_var(bdp_ratelimits);
 	*p += nr_pages_dirtied;
 	if (unlikely(*p >= ratelimit)) {
-		ratelimit = sync_writeback_pages(*p);
+		ratelimit = *p;
 		*p = 0;
 		preempt_enable();
 		balance_dirty_pages(mapping, ratelimit);
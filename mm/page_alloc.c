@@ -1224,6 +1224,120 @@ out:
 	local_irq_restore(flags);
 }
 
+/*
+ * A zone's worth of pages freed together that is at least this large skips
+ * the per-cpu lists; larger runs are split so that zone->lock is not held
+ * with interrupts off for too long.
+ */
+#define FREE_BULK_MIN		SWAP_CLUSTER_MAX
+#define FREE_BULK_MAX		(8 * SWAP_CLUSTER_MAX)
+
+/*
+ * Free @count 0-order pages of @zone, linked on @list, to the buddy
+ * allocator under a single zone->lock hold.
+ */
+static void free_zone_pages_bulk(struct zone *zone, struct list_head *list,
+				 int count, int cold)
+{
+	struct page *page, *next;
+	unsigned long flags;
+	int nr_mlocked = 0;
+
+	if (count < FREE_BULK_MIN) {
+		list_for_each_entry_safe(page, next, list, lru) {
+			list_del(&page->lru);
+			free_hot_cold_page(page, cold);
+		}
+		return;
+	}
+
+	list_for_each_entry_safe(page, next, list, lru) {
+		if (unlikely(__TestClearPageMlocked(page)))
+			nr_mlocked++;
+		if (!free_pages_prepare(page, 0)) {
+			list_del(&page->lru);
+			count--;
+			continue;
+		}
+		set_page_private(page, get_pageblock_migratetype(page));
+	}
+
+	spin_lock_irqsave(&zone->lock, flags);
+	zone->all_unreclaimable = 0;
+	zone->pages_scanned = 0;
+
+	list_for_each_entry_safe(page, next, list, lru) {
+		/* must delete as __free_one_page list manipulates */
+		list_del(&page->lru);
+		__free_one_page(page, zone, 0, page_private(page));
+	}
+	__mod_zone_page_state(zone, NR_FREE_PAGES, count);
+	if (unlikely(nr_mlocked)) {
+		__mod_zone_page_state(zone, NR_MLOCK, -nr_mlocked);
+		__count_vm_events(UNEVICTABLE_MLOCKFREED, nr_mlocked);
+	}
+	__count_vm_events(PGFREE, count);
+	spin_unlock_irqrestore(&zone->lock, flags);
+}
+
+/**
+ * free_hot_cold_page_list - free a list of 0-order pages
+ * @list: pages to free, linked through page->lru
+ * @cold: whether the pages are cache cold
+ *
+ * Sorts the pages by zone and returns each zone's pages to the buddy
+ * allocator in one go, instead of trickling them through the per-cpu
+ * lists and taking zone->lock every pcp->batch pages.  Used when tearing
+ * down large mappings in munmap() and exit_mmap().  Small groups still go
+ * through free_hot_cold_page().
+ */
+void free_hot_cold_page_list(struct list_head *list, int cold)
+{
+	struct list_head zone_pages[MAX_NR_ZONES];
+	int zone_count[MAX_NR_ZONES];
+	pg_data_t *pgdat = NULL;
+	struct page *page, *next;
+	int i;
+
+	for (i = 0; i < MAX_NR_ZONES; i++) {
+		INIT_LIST_HEAD(&zone_pages[i]);
+		zone_count[i] = 0;
+	}
+
+	list_for_each_entry_safe(page, next, list, lru) {
+		struct zone *zone = page_zone(page);
+		int zid = zone_idx(zone);
+
+		trace_mm_pagevec_free(page, cold);
+
+		/* Pages of another node: flush what we have so far */
+		if (zone->zone_pgdat != pgdat) {
+			for (i = 0; pgdat && i < MAX_NR_ZONES; i++) {
+				if (!zone_count[i])
+					continue;
+				free_zone_pages_bulk(&pgdat->node_zones[i],
+						&zone_pages[i], zone_count[i],
+						cold);
+				zone_count[i] = 0;
+			}
+			pgdat = zone->zone_pgdat;
+		}
+
+		list_move(&page->lru, &zone_pages[zid]);
+		if (++zone_count[zid] == FREE_BULK_MAX) {
+			free_zone_pages_bulk(zone, &zone_pages[zid],
+					     zone_count[zid], cold);
+			zone_count[zid] = 0;
+		}
+	}
+
+	for (i = 0; pgdat && i < MAX_NR_ZONES; i++) {
+		if (zone_count[i])
+			free_zone_pages_bulk(&pgdat->node_zones[i],
+					     &zone_pages[i], zone_count[i], cold);
+	}
+}
+
 /*
  * split_page takes a non-compound higher-order page, and splits it into
  * n (1<<order) sub-pages: page[0..n]
@@ -4319,6 +4433,9 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat->nr_zones = 0;
 	init_waitqueue_head(&pgdat->kswapd_wait);
 	pgdat->kswapd_max_order = 0;
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+#endif
 	pgdat_page_cgroup_init(pgdat);
 	
 	for (j = 0; j < MAX_NR_ZONES; j++) {
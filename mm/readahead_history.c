@@ -0,0 +1,317 @@
+/*
+ * mm/readahead_history.c - replay page fault history as readahead
+ *
+ * Applications map their code and data (shared libraries, dex/odex files)
+ * and fault it in a page cluster at a time, in an order that mmap
+ * read-around cannot predict.  Launching the same application again after
+ * its pages were reclaimed repeats the same major faults, one synchronous
+ * read each.
+ *
+ * This remembers where in a file major faults happened, as a short list of
+ * page clusters per inode, and the next time the file is opened for reading
+ * it submits readahead for those clusters from a worker thread, so that the
+ * faults find their pages already in (or on their way into) the page cache.
+ *
+ * Histories are keyed by device, inode number and generation, so that they
+ * outlive the inode itself being reclaimed, and are thrown away when the
+ * file's size or mtime changes.  They are kept on an LRU that is trimmed by
+ * a shrinker under memory pressure.
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/hash.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/pagemap.h>
+#include <linux/workqueue.h>
+#include <linux/vmstat.h>
+#include <linux/init.h>
+
+/* Maximum number of fault clusters remembered per file */
+#define RA_HISTORY_CLUSTERS	32
+/* Maximum number of files with a history */
+#define RA_HISTORY_MAX		512
+
+#define RA_HISTORY_HASH_BITS	8
+#define RA_HISTORY_HASH_SIZE	(1 << RA_HISTORY_HASH_BITS)
+
+struct ra_cluster {
+	pgoff_t		start;
+	unsigned long	nr_pages;
+};
+
+struct ra_history {
+	struct hlist_node	hash;
+	struct list_head	lru;
+	dev_t			dev;
+	unsigned long		ino;
+	u32			generation;
+	loff_t			size;
+	struct timespec		mtime;
+	unsigned int		nr_clusters;
+	struct ra_cluster	clusters[RA_HISTORY_CLUSTERS];
+};
+
+struct ra_replay {
+	struct work_struct	work;
+	struct file		*file;
+	unsigned int		nr_clusters;
+	struct ra_cluster	clusters[RA_HISTORY_CLUSTERS];
+};
+
+int sysctl_readahead_history = 1;
+
+static DEFINE_SPINLOCK(ra_history_lock);
+static struct hlist_head ra_history_hash[RA_HISTORY_HASH_SIZE];
+static LIST_HEAD(ra_history_lru);
+static unsigned int ra_history_count;
+static struct kmem_cache *ra_history_cachep;
+
+static struct hlist_head *ra_history_bucket(struct inode *inode)
+{
+	unsigned long key = inode->i_ino ^ inode->i_sb->s_dev;
+
+	return &ra_history_hash[hash_long(key, RA_HISTORY_HASH_BITS)];
+}
+
+/* Called with ra_history_lock held */
+static struct ra_history *ra_history_find(struct inode *inode)
+{
+	struct hlist_head *head = ra_history_bucket(inode);
+	struct hlist_node *node;
+	struct ra_history *h;
+
+	hlist_for_each_entry(h, node, head, hash) {
+		if (h->ino == inode->i_ino &&
+		    h->dev == inode->i_sb->s_dev &&
+		    h->generation == inode->i_generation)
+			return h;
+	}
+	return NULL;
+}
+
+static bool ra_history_stale(struct ra_history *h, struct inode *inode)
+{
+	return h->size != i_size_read(inode) ||
+	       !timespec_equal(&h->mtime, &inode->i_mtime);
+}
+
+/* Called with ra_history_lock held */
+static void ra_history_evict(struct ra_history *h)
+{
+	hlist_del(&h->hash);
+	list_del(&h->lru);
+	ra_history_count--;
+	kmem_cache_free(ra_history_cachep, h);
+}
+
+static void ra_history_add_cluster(struct ra_history *h, pgoff_t start,
+				   unsigned long nr_pages)
+{
+	pgoff_t end = start + nr_pages;
+	unsigned int i;
+
+	for (i = 0; i < h->nr_clusters; i++) {
+		struct ra_cluster *c = &h->clusters[i];
+		pgoff_t c_end = c->start + c->nr_pages;
+
+		/* Overlapping or adjacent: grow the existing cluster */
+		if (start <= c_end && c->start <= end) {
+			c->start = min(c->start, start);
+			c->nr_pages = max(c_end, end) - c->start;
+			return;
+		}
+	}
+
+	/* Startup faults come first; later ones don't fit and aren't kept */
+	if (h->nr_clusters < RA_HISTORY_CLUSTERS) {
+		h->clusters[h->nr_clusters].start = start;
+		h->clusters[h->nr_clusters].nr_pages = nr_pages;
+		h->nr_clusters++;
+	}
+}
+
+/**
+ * readahead_history_fault - record a major fault on a file mapping
+ * @file: the mapped file
+ * @offset: page index that was not in the page cache
+ *
+ * Called from filemap_fault() for major faults.  The cluster remembered is
+ * the read-around window do_sync_mmap_readahead() uses for @offset.
+ */
+void readahead_history_fault(struct file *file, pgoff_t offset)
+{
+	struct inode *inode = file->f_mapping->host;
+	unsigned long ra_pages = file->f_ra.ra_pages;
+	struct ra_history *h, *new = NULL;
+	pgoff_t start;
+
+	if (!sysctl_readahead_history || !ra_pages)
+		return;
+
+	start = offset > ra_pages / 2 ? offset - ra_pages / 2 : 0;
+
+	spin_lock(&ra_history_lock);
+	h = ra_history_find(inode);
+	if (!h) {
+		spin_unlock(&ra_history_lock);
+		new = kmem_cache_alloc(ra_history_cachep,
+				       GFP_KERNEL | __GFP_NOWARN);
+		if (!new)
+			return;
+		spin_lock(&ra_history_lock);
+		h = ra_history_find(inode);
+	}
+	if (!h) {
+		h = new;
+		new = NULL;
+		h->dev = inode->i_sb->s_dev;
+		h->ino = inode->i_ino;
+		h->generation = inode->i_generation;
+		h->size = i_size_read(inode);
+		h->mtime = inode->i_mtime;
+		h->nr_clusters = 0;
+		hlist_add_head(&h->hash, ra_history_bucket(inode));
+		list_add(&h->lru, &ra_history_lru);
+		if (++ra_history_count > RA_HISTORY_MAX)
+			ra_history_evict(list_entry(ra_history_lru.prev,
+						    struct ra_history, lru));
+	} else if (ra_history_stale(h, inode)) {
+		/* The file changed, so did the layout of what is faulted */
+		h->size = i_size_read(inode);
+		h->mtime = inode->i_mtime;
+		h->nr_clusters = 0;
+	}
+
+	ra_history_add_cluster(h, start, ra_pages);
+	list_move(&h->lru, &ra_history_lru);
+	spin_unlock(&ra_history_lock);
+
+	if (new)
+		kmem_cache_free(ra_history_cachep, new);
+}
+
+static void ra_history_replay_work(struct work_struct *work)
+{
+	struct ra_replay *r = container_of(work, struct ra_replay, work);
+	struct file *file = r->file;
+	unsigned int i;
+
+	for (i = 0; i < r->nr_clusters; i++)
+		force_page_cache_readahead(file->f_mapping, file,
+					   r->clusters[i].start,
+					   r->clusters[i].nr_pages);
+	count_vm_events(RAHIST_REPLAY, r->nr_clusters);
+
+	fput(file);
+	kfree(r);
+}
+
+/* The page at @index is cached, so its cluster needs no replaying */
+static bool ra_history_cached(struct address_space *mapping, pgoff_t index)
+{
+	struct page *page = find_get_page(mapping, index);
+
+	if (!page)
+		return false;
+	page_cache_release(page);
+	return true;
+}
+
+/**
+ * readahead_history_open - replay the fault history of a file being opened
+ * @file: the file, opened for reading
+ *
+ * Queues readahead for the clusters of the file that were faulted in
+ * before and are not in the page cache now.
+ */
+void readahead_history_open(struct file *file)
+{
+	struct inode *inode = file->f_mapping->host;
+	struct ra_replay *r;
+	struct ra_history *h;
+	unsigned int i, nr;
+
+	if (!sysctl_readahead_history || !S_ISREG(inode->i_mode) ||
+	    !(file->f_mode & FMODE_READ) || (file->f_flags & O_DIRECT) ||
+	    !file->f_ra.ra_pages)
+		return;
+
+	/* Most files opened have no history: don't allocate for those */
+	spin_lock(&ra_history_lock);
+	h = ra_history_find(inode);
+	spin_unlock(&ra_history_lock);
+	if (!h)
+		return;
+
+	r = kmalloc(sizeof(*r), GFP_KERNEL | __GFP_NOWARN);
+	if (!r)
+		return;
+
+	spin_lock(&ra_history_lock);
+	h = ra_history_find(inode);
+	if (!h || ra_history_stale(h, inode)) {
+		spin_unlock(&ra_history_lock);
+		kfree(r);
+		return;
+	}
+	r->nr_clusters = h->nr_clusters;
+	memcpy(r->clusters, h->clusters,
+	       h->nr_clusters * sizeof(struct ra_cluster));
+	list_move(&h->lru, &ra_history_lru);
+	spin_unlock(&ra_history_lock);
+
+	/* Skip what is still cached, which is the common case */
+	for (i = nr = 0; i < r->nr_clusters; i++) {
+		if (ra_history_cached(file->f_mapping, r->clusters[i].start))
+			continue;
+		r->clusters[nr++] = r->clusters[i];
+	}
+	if (!nr) {
+		kfree(r);
+		return;
+	}
+	r->nr_clusters = nr;
+
+	get_file(file);
+	r->file = file;
+	INIT_WORK(&r->work, ra_history_replay_work);
+	queue_work(system_unbound_wq, &r->work);
+}
+
+static int ra_history_shrink(struct shrinker *shrink,
+			     struct shrink_control *sc)
+{
+	unsigned long nr_to_scan = sc->nr_to_scan;
+
+	if (nr_to_scan) {
+		spin_lock(&ra_history_lock);
+		while (nr_to_scan-- && !list_empty(&ra_history_lru))
+			ra_history_evict(list_entry(ra_history_lru.prev,
+						    struct ra_history, lru));
+		spin_unlock(&ra_history_lock);
+	}
+	return ra_history_count;
+}
+
+static struct shrinker ra_history_shrinker = {
+	.shrink = ra_history_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static int __init readahead_history_init(void)
+{
+	int i;
+
+	for (i = 0; i < RA_HISTORY_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&ra_history_hash[i]);
+
+	ra_history_cachep = KMEM_CACHE(ra_history, SLAB_PANIC);
+	register_shrinker(&ra_history_shrinker);
+	return 0;
+}
+module_init(readahead_history_init);
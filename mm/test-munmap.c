@@ -0,0 +1,102 @@
+/*
+ * Address space teardown microbenchmark.
+ *
+ * Maps rss_mb of anonymous memory into the address space of the process
+ * loading the module (insmod), faults all of it in, and times unmapping
+ * it again.  munmap() frees the pages through the same mmu_gather,
+ * free_pages_and_swap_cache() and release_pages() path as exit_mmap(),
+ * so this is what dominates the time from a process being killed to its
+ * memory being free again:
+ *
+ *	insmod test-munmap.ko rss_mb=100 runs=5
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/vmstat.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/err.h>
+
+static unsigned int rss_mb = 100;
+module_param(rss_mb, uint, 0);
+MODULE_PARM_DESC(rss_mb, "Size of the mapping to tear down (MiB)");
+
+static unsigned int runs = 5;
+module_param(runs, uint, 0);
+MODULE_PARM_DESC(runs, "Number of map/unmap rounds");
+
+/* Map, populate and unmap once; returns the unmap time in us */
+static long __init munmap_one(unsigned long len)
+{
+	struct mm_struct *mm = current->mm;
+	unsigned long addr;
+	ktime_t start;
+	int err;
+
+	down_write(&mm->mmap_sem);
+	addr = do_mmap_pgoff(NULL, 0, len, PROT_READ | PROT_WRITE,
+			     MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, 0);
+	up_write(&mm->mmap_sem);
+	if (IS_ERR_VALUE(addr))
+		return addr;
+
+	down_write(&mm->mmap_sem);
+	start = ktime_get();
+	err = do_munmap(mm, addr, len);
+	up_write(&mm->mmap_sem);
+	if (err)
+		return err;
+
+	return div_u64(ktime_to_ns(ktime_sub(ktime_get(), start)),
+		       NSEC_PER_USEC);
+}
+
+static int __init test_munmap_init(void)
+{
+	unsigned long len = (unsigned long)rss_mb << 20;
+	unsigned long pages = len >> PAGE_SHIFT;
+	unsigned long total = 0, best = ULONG_MAX;
+	unsigned int i;
+	long us;
+
+	if (!current->mm || !runs || !len)
+		return -EINVAL;
+
+	for (i = 0; i < runs; i++) {
+		us = munmap_one(len);
+		if (us < 0) {
+			pr_err("munmap: round %u failed: %ld\n", i, us);
+			return us;
+		}
+		total += us;
+		if (us < best)
+			best = us;
+		cond_resched();
+	}
+
+	total /= runs;
+	pr_info("munmap: %u MiB (%lu pages) torn down in %lu.%03lu ms "
+		"(best %lu.%03lu ms): %lu pages/ms\n",
+		rss_mb, pages, total / 1000, total % 1000,
+		best / 1000, best % 1000, total ? pages * 1000 / total : 0);
+
+	/*
+	 * The mappings came and went in insmod's own address space, so
+	 * there is nothing to clean up on unload: just refuse to load.
+	 */
+	return -EAGAIN;
+}
+module_init(test_munmap_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Address space teardown microbenchmark");
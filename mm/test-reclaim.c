@@ -0,0 +1,195 @@
+/*
+ * Page reclaim microbenchmark.
+ *
+ * Reads a file into the page cache, then allocates pages until reclaim
+ * has had to free reclaim_mb worth of memory, and reports how many pages
+ * were reclaimed per millisecond while doing so, and how many of them
+ * went through the clean page cache fast path (pgsteal_clean).  The file
+ * should be large and not otherwise in use, so that most of what gets
+ * reclaimed is clean, unmapped cache:
+ *
+ *	insmod test-reclaim.ko file=/sdcard/big.bin reclaim_mb=32
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/slab.h>
+#include <linux/swap.h>
+#include <linux/vmstat.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/err.h>
+#include <asm/uaccess.h>
+
+static char *file;
+module_param(file, charp, 0);
+MODULE_PARM_DESC(file, "File to fill the page cache with");
+
+static unsigned int reclaim_mb = 32;
+module_param(reclaim_mb, uint, 0);
+MODULE_PARM_DESC(reclaim_mb, "Amount of memory reclaim has to free (MiB)");
+
+struct reclaim_events {
+	unsigned long steal;
+	unsigned long steal_clean;
+	unsigned long scan;
+};
+
+static void __init reclaim_events(unsigned long *ev, struct reclaim_events *r)
+{
+	int i;
+
+	all_vm_events(ev);
+	memset(r, 0, sizeof(*r));
+	for (i = PGREFILL_MOVABLE + 1; i <= PGSTEAL_MOVABLE; i++)
+		r->steal += ev[i];
+	for (i = PGSTEAL_MOVABLE + 1; i <= PGSCAN_DIRECT_MOVABLE; i++)
+		r->scan += ev[i];
+	r->steal_clean = ev[PGSTEAL_CLEAN];
+}
+
+/* Read all of @path through the page cache, returns the pages read */
+static long __init reclaim_fill_cache(const char *path)
+{
+	struct file *filp;
+	void *buf;
+	loff_t pos = 0;
+	mm_segment_t old_fs;
+	ssize_t ret;
+
+	filp = filp_open(path, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(filp))
+		return PTR_ERR(filp);
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf) {
+		fput(filp);
+		return -ENOMEM;
+	}
+
+	old_fs = get_fs();
+	set_fs(KERNEL_DS);
+	do {
+		ret = vfs_read(filp, (char __user *)buf, PAGE_SIZE, &pos);
+		cond_resched();
+	} while (ret > 0 && !fatal_signal_pending(current));
+	set_fs(old_fs);
+
+	kfree(buf);
+	fput(filp);
+
+	return ret < 0 ? ret : pos >> PAGE_SHIFT;
+}
+
+static void __init reclaim_free_pages(struct list_head *pages)
+{
+	struct page *page, *next;
+
+	list_for_each_entry_safe(page, next, pages, lru) {
+		list_del(&page->lru);
+		__free_page(page);
+	}
+}
+
+static int __init test_reclaim_init(void)
+{
+	const gfp_t gfp = GFP_HIGHUSER | __GFP_NOWARN | __GFP_NORETRY;
+	unsigned long target = (unsigned long)reclaim_mb << (20 - PAGE_SHIFT);
+	struct reclaim_events before, after;
+	unsigned long *ev;
+	unsigned long nr_alloc = 0, steal, us;
+	LIST_HEAD(pages);
+	struct page *page;
+	ktime_t start;
+	long cached;
+	int err = 0;
+
+	if (!file) {
+		pr_err("reclaim: no file= given\n");
+		return -EINVAL;
+	}
+
+	ev = kmalloc(NR_VM_EVENT_ITEMS * sizeof(*ev), GFP_KERNEL);
+	if (!ev)
+		return -ENOMEM;
+
+	cached = reclaim_fill_cache(file);
+	if (cached < 0) {
+		pr_err("reclaim: reading %s failed: %ld\n", file, cached);
+		err = cached;
+		goto out;
+	}
+	pr_info("reclaim: %s: %ld pages read, %lu pages free\n",
+		file, cached, global_page_state(NR_FREE_PAGES));
+
+	/*
+	 * Use up free memory until reclaim kicks in, so that only reclaim
+	 * is being timed below.
+	 */
+	reclaim_events(ev, &before);
+	for (;;) {
+		page = alloc_page(gfp);
+		if (!page)
+			break;
+		list_add(&page->lru, &pages);
+		nr_alloc++;
+		if (!(nr_alloc % 64)) {
+			reclaim_events(ev, &after);
+			if (after.steal != before.steal)
+				break;
+			cond_resched();
+		}
+	}
+
+	reclaim_events(ev, &before);
+	start = ktime_get();
+	for (steal = 0; steal < target; ) {
+		page = alloc_page(gfp);
+		if (!page || fatal_signal_pending(current)) {
+			if (page)
+				__free_page(page);
+			pr_warning("reclaim: ran out of reclaimable memory\n");
+			break;
+		}
+		list_add(&page->lru, &pages);
+		nr_alloc++;
+		if (!(nr_alloc % 64)) {
+			reclaim_events(ev, &after);
+			steal = after.steal - before.steal;
+		}
+	}
+	us = div_u64(ktime_to_ns(ktime_sub(ktime_get(), start)), NSEC_PER_USEC);
+	reclaim_events(ev, &after);
+
+	steal = after.steal - before.steal;
+	pr_info("reclaim: %lu pages reclaimed (%lu scanned, %lu clean fast "
+		"path) in %lu.%03lu ms: %lu pages/ms\n",
+		steal, after.scan - before.scan,
+		after.steal_clean - before.steal_clean,
+		us / 1000, us % 1000, us ? steal * 1000 / us : 0);
+
+	reclaim_free_pages(&pages);
+out:
+	kfree(ev);
+
+	/*
+	 * Every load reads the file back into the page cache and reclaims
+	 * it again, so a run is repeated by loading the module again.
+	 */
+	return err ? err : -EAGAIN;
+}
+module_init(test_reclaim_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Page reclaim microbenchmark");
@@ -183,6 +183,55 @@ int invalidate_inode_page(struct page *page)
 	return invalidate_complete_page(mapping, page);
 }
 
+/*
+ * Remove the shadow entries that reclaim left in place of evicted pages
+ * in [start, end]: they describe data that is no longer there.
+ */
+static void clear_shadow_entries(struct address_space *mapping,
+				 pgoff_t start, pgoff_t end)
+{
+	void **slots[PAGEVEC_SIZE];
+	pgoff_t indices[PAGEVEC_SIZE];
+	pgoff_t next = start;
+	unsigned int nr_found;
+	long nr_cleared;
+	int i;
+
+	while (next <= end) {
+		spin_lock_irq(&mapping->tree_lock);
+		if (!mapping->nrshadows) {
+			spin_unlock_irq(&mapping->tree_lock);
+			break;
+		}
+		nr_found = radix_tree_gang_lookup_slot(&mapping->page_tree,
+				slots, indices, next, PAGEVEC_SIZE);
+		nr_cleared = 0;
+		for (i = 0; i < nr_found; i++) {
+			void *entry;
+
+			if (indices[i] > end)
+				break;
+			entry = radix_tree_deref_slot_protected(slots[i],
+							&mapping->tree_lock);
+			if (!radix_tree_exceptional_entry(entry))
+				continue;
+			radix_tree_delete(&mapping->page_tree, indices[i]);
+			mapping->nrshadows--;
+			nr_cleared++;
+		}
+		if (nr_cleared)
+			workingset_shadows_changed(mapping, -nr_cleared);
+		spin_unlock_irq(&mapping->tree_lock);
+
+		if (!nr_found || i < nr_found)
+			break;
+		next = indices[nr_found - 1] + 1;
+		if (!next)
+			break;
+		cond_resched();
+	}
+}
+
 /**
  * truncate_inode_pages - truncate range of pages specified by start & end byte offsets
  * @mapping: mapping to truncate
@@ -217,8 +266,12 @@ void truncate_inode_pages_range(struct address_space *mapping,
 	int i;
 
 	cleancache_flush_inode(mapping);
-	if (mapping->nrpages == 0)
-		return;
+	if (mapping->nrpages == 0) {
+		/* Pairs with the smp_wmb() in __delete_from_page_cache() */
+		smp_rmb();
+		if (mapping->nrshadows == 0)
+			return;
+	}
 
 	BUG_ON((lend & (PAGE_CACHE_SIZE - 1)) != (PAGE_CACHE_SIZE - 1));
 	end = (lend >> PAGE_CACHE_SHIFT);
@@ -294,6 +347,7 @@ void truncate_inode_pages_range(struct address_space *mapping,
 		pagevec_release(&pvec);
 		mem_cgroup_uncharge_end();
 	}
+	clear_shadow_entries(mapping, start, end);
 	cleancache_flush_inode(mapping);
 }
 EXPORT_SYMBOL(truncate_inode_pages_range);
@@ -404,7 +458,7 @@ invalidate_complete_page2(struct address_space *mapping, struct page *page)
 
 	clear_page_mlock(page);
 	BUG_ON(page_has_private(page));
-	__delete_from_page_cache(page);
+	__delete_from_page_cache(page, NULL);
 	spin_unlock_irq(&mapping->tree_lock);
 	mem_cgroup_uncharge_cache_page(page);
 
@@ -479,9 +479,11 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
 
 /*
  * Same as remove_mapping, but if the page is removed from the mapping, it
- * gets returned with a refcount of 0.
+ * gets returned with a refcount of 0.  If @reclaimed, a file page leaves
+ * a shadow entry behind for refault detection.
  */
-static int __remove_mapping(struct address_space *mapping, struct page *page)
+static int __remove_mapping(struct address_space *mapping, struct page *page,
+			    bool reclaimed)
 {
 	BUG_ON(!PageLocked(page));
 	BUG_ON(mapping != page_mapping(page));
@@ -527,10 +529,13 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		swapcache_free(swap, page);
 	} else {
 		void (*freepage)(struct page *);
+		void *shadow = NULL;
 
 		freepage = mapping->a_ops->freepage;
 
-		__delete_from_page_cache(page);
+		if (reclaimed && page_is_file_cache(page))
+			shadow = workingset_eviction(mapping, page);
+		__delete_from_page_cache(page, shadow);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
 
@@ -553,7 +558,7 @@ cannot_free:
  */
 int remove_mapping(struct address_space *mapping, struct page *page)
 {
-	if (__remove_mapping(mapping, page)) {
+	if (__remove_mapping(mapping, page, false)) {
 		/*
 		 * Unfreezing the refcount with 1 rather than 2 effectively
 		 * drops the pagecache ref for us without requiring another
@@ -714,6 +719,126 @@ static noinline_for_stack void free_page_list(struct list_head *free_pages)
 	pagevec_free(&freed_pvec);
 }
 
+/*
+ * Take the locked pages in @pvec, which all belong to @mapping, out of the
+ * page cache under a single tree_lock hold.  Pages that someone else got a
+ * reference to or dirtied in the meantime go on @keep_pages, still locked;
+ * the rest end up on @free_pages.  Returns the number of pages freed.
+ */
+static unsigned long remove_mapping_batch(struct address_space *mapping,
+					  struct pagevec *pvec,
+					  struct list_head *keep_pages,
+					  struct list_head *free_pages)
+{
+	void (*freepage)(struct page *) = mapping->a_ops->freepage;
+	unsigned long nr_reclaimed = 0;
+	int i;
+
+	spin_lock_irq(&mapping->tree_lock);
+	for (i = 0; i < pagevec_count(pvec); i++) {
+		struct page *page = pvec->pages[i];
+
+		/* See __remove_mapping() for the order of these tests */
+		if (!page_freeze_refs(page, 2))
+			goto keep;
+		if (unlikely(PageDirty(page))) {
+			page_unfreeze_refs(page, 2);
+			goto keep;
+		}
+		__delete_from_page_cache(page,
+					 workingset_eviction(mapping, page));
+		continue;
+keep:
+		pvec->pages[i] = NULL;
+		list_add(&page->lru, keep_pages);
+	}
+	spin_unlock_irq(&mapping->tree_lock);
+
+	for (i = 0; i < pagevec_count(pvec); i++) {
+		struct page *page = pvec->pages[i];
+
+		if (!page)
+			continue;
+		mem_cgroup_uncharge_cache_page(page);
+		if (freepage != NULL)
+			freepage(page);
+		/* No references left, see shrink_page_list() */
+		__clear_page_locked(page);
+		list_add(&page->lru, free_pages);
+		nr_reclaimed++;
+	}
+	pagevec_reinit(pvec);
+
+	return nr_reclaimed;
+}
+
+/*
+ * Fast path for the common case of an inactive file list full of clean
+ * page cache that nobody has mapped: free such pages without going through
+ * shrink_page_list(), batching the page cache removals per address_space.
+ * Pages that need a closer look (mapped, dirty, under writeback, with
+ * buffers, mlocked) are left on @page_list for shrink_page_list().
+ */
+static unsigned long shrink_clean_cache(struct list_head *page_list,
+					struct zone *zone,
+					struct scan_control *sc)
+{
+	LIST_HEAD(keep_pages);
+	LIST_HEAD(free_pages);
+	struct address_space *mapping = NULL;
+	struct pagevec pvec;
+	struct page *page, *next;
+	unsigned long nr_reclaimed = 0;
+
+	pagevec_init(&pvec, 1);
+
+	list_for_each_entry_safe(page, next, page_list, lru) {
+		if (PageDirty(page) || PageWriteback(page) ||
+		    page_mapped(page) || page_has_private(page) ||
+		    PageSwapBacked(page) || !page->mapping)
+			continue;
+		if (!trylock_page(page))
+			continue;
+
+		VM_BUG_ON(PageActive(page));
+		VM_BUG_ON(page_zone(page) != zone);
+
+		/* Recheck under the page lock */
+		if (unlikely(PageDirty(page) || PageWriteback(page) ||
+			     page_mapped(page) || page_has_private(page) ||
+			     !page->mapping || !page_evictable(page, NULL))) {
+			unlock_page(page);
+			continue;
+		}
+
+		if (page->mapping != mapping || !pagevec_space(&pvec)) {
+			if (pagevec_count(&pvec))
+				nr_reclaimed += remove_mapping_batch(mapping,
+						&pvec, &keep_pages, &free_pages);
+			mapping = page->mapping;
+		}
+
+		/* Unmapped: only the PG_referenced hint can be set */
+		ClearPageReferenced(page);
+		list_del(&page->lru);
+		pagevec_add(&pvec, page);
+	}
+	if (pagevec_count(&pvec))
+		nr_reclaimed += remove_mapping_batch(mapping, &pvec,
+						     &keep_pages, &free_pages);
+
+	/* Kept pages are scanned again, and counted, by shrink_page_list() */
+	list_for_each_entry(page, &keep_pages, lru)
+		unlock_page(page);
+	list_splice(&keep_pages, page_list);
+
+	free_page_list(&free_pages);
+	sc->nr_scanned += nr_reclaimed;
+	count_vm_events(PGSTEAL_CLEAN, nr_reclaimed);
+
+	return nr_reclaimed;
+}
+
 /*
  * shrink_page_list() returns the number of reclaimed pages
  */
@@ -901,7 +1026,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		if (!mapping || !__remove_mapping(mapping, page))
+		if (!mapping || !__remove_mapping(mapping, page, true))
 			goto keep_locked;
 
 		/*
@@ -1456,7 +1581,9 @@ shrink_inactive_list(unsigned long nr_to_scan, struct zone *zone,
 
 	spin_unlock_irq(&zone->lru_lock);
 
-	nr_reclaimed = shrink_page_list(&page_list, zone, sc);
+	if (file)
+		nr_reclaimed = shrink_clean_cache(&page_list, zone, sc);
+	nr_reclaimed += shrink_page_list(&page_list, zone, sc);
 
 	/* Check if we should syncronously wait for writeback */
 	if (should_reclaim_stall(nr_taken, nr_reclaimed, priority, sc)) {
@@ -2674,6 +2801,13 @@ static void kswapd_try_to_sleep(pg_data_t *pgdat, int order, int classzone_idx)
 
 	/* Try to sleep for a short interval */
 	if (!sleeping_prematurely(pgdat, order, remaining, classzone_idx)) {
+		/*
+		 * The node is balanced: let kcompactd defragment what
+		 * reclaim has freed before high-order allocations have
+		 * to compact it themselves.
+		 */
+		wakeup_kcompactd(pgdat, order, classzone_idx);
+
 		remaining = schedule_timeout(HZ/10);
 		finish_wait(&pgdat->kswapd_wait, &wait);
 		prepare_to_wait(&pgdat->kswapd_wait, &wait, TASK_INTERRUPTIBLE);
@@ -0,0 +1,280 @@
+/*
+ * mm/workingset.c
+ *
+ * Working set detection for the page cache.
+ *
+ * A large streaming read can push the whole inactive file list out of
+ * memory in one pass, taking frequently used pages along with it before
+ * they were ever referenced twice, and so never made it to the active
+ * list.  To tell those apart from the stream, reclaim leaves a "shadow"
+ * entry in the page cache radix tree in place of every file page it
+ * evicts, recording how far the zone's inactive list had moved at the time.
+ *
+ * Every eviction and every activation advances the zone's inactive_age.
+ * When the page is read back in, the difference between inactive_age now
+ * and in the shadow entry - the refault distance - is the minimum number
+ * of inactive list slots the page would have needed to still be resident.
+ * If the active list holds at least that many pages, the page could have
+ * stayed in memory by displacing active pages, so it is put straight on
+ * the active list instead of being left to the next stream.
+ *
+ * Shadow entries go away when the page is read back in, when the file is
+ * truncated, and when the inode is evicted.  They cost a radix tree slot,
+ * and keep radix tree nodes of files that stay cached alive, so they are
+ * also reclaimed by a shrinker.  A shadow entry is only of use while its
+ * refault distance is smaller than the active file list.  Every eviction
+ * moves all the others one further away, so no more shadow entries than
+ * there are active file pages can be of use at any time.  Beyond that
+ * number, the shrinker goes round the mappings that have shadow entries
+ * and drops those that are already too old to activate their page.
+ */
+
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/swap.h>
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/pagevec.h>
+#include <linux/radix-tree.h>
+#include <linux/spinlock.h>
+#include <linux/vmstat.h>
+
+/* Mappings with shadow entries, nested inside their tree_lock */
+static LIST_HEAD(shadow_mappings);
+static DEFINE_SPINLOCK(shadow_lock);
+static atomic_long_t nr_shadows = ATOMIC_LONG_INIT(0);
+
+static void *pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	eviction = (eviction << RADIX_TREE_EXCEPTIONAL_SHIFT);
+
+	return (void *)(eviction | RADIX_TREE_EXCEPTIONAL_ENTRY);
+}
+
+static void unpack_shadow(void *shadow, struct zone **zone,
+			  unsigned long *distance)
+{
+	unsigned long entry = (unsigned long)shadow;
+	unsigned long eviction;
+	unsigned long refault;
+	unsigned long mask;
+	int zid, nid;
+
+	entry >>= RADIX_TREE_EXCEPTIONAL_SHIFT;
+	zid = entry & ((1UL << ZONES_SHIFT) - 1);
+	entry >>= ZONES_SHIFT;
+	nid = entry & ((1UL << NODES_SHIFT) - 1);
+	entry >>= NODES_SHIFT;
+	eviction = entry;
+
+	*zone = NODE_DATA(nid)->node_zones + zid;
+
+	refault = atomic_long_read(&(*zone)->inactive_age);
+	mask = ~0UL >> (NODES_SHIFT + ZONES_SHIFT +
+			RADIX_TREE_EXCEPTIONAL_SHIFT);
+	/*
+	 * The unsigned subtraction here gives an accurate distance
+	 * across inactive_age overflows in most cases.
+	 *
+	 * There is a special case: usually, shadow entries have a
+	 * short lifetime and are either refaulted or reclaimed along
+	 * with the inode before they get too old.  But it is not
+	 * impossible for the inactive_age to lap a shadow entry in
+	 * the field, which can then result in a false small
+	 * refault distance, leading to a false activation should this
+	 * old entry actually refault again.  However, earlier kernels
+	 * used to deactivate unconditionally with *every* reclaim
+	 * invocation for the longest time, so the occasional
+	 * inappropriate activation leading to pressure on the active
+	 * list is not a problem.
+	 */
+	*distance = (refault - eviction) & mask;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page from memory
+ * @mapping: address space the page was backing
+ * @page: the page being evicted
+ *
+ * Returns a shadow entry to be stored in @mapping->page_tree in place
+ * of the evicted @page so that a later refault can be detected.
+ */
+void *workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long eviction;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	return pack_shadow(eviction, zone);
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @shadow: shadow entry of the evicted page
+ *
+ * Calculates and evaluates the refault distance of the previously
+ * evicted page in the context of the zone it was allocated in.
+ *
+ * Returns %true if the page should be activated, %false otherwise.
+ */
+bool workingset_refault(void *shadow)
+{
+	unsigned long refault_distance;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &refault_distance);
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+
+	if (refault_distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+/**
+ * workingset_shadows_changed - account shadow entries of a mapping
+ * @mapping: address space whose nrshadows was changed
+ * @delta: number of shadow entries added, or removed if negative
+ *
+ * Called with @mapping->tree_lock held, after updating nrshadows.
+ */
+void workingset_shadows_changed(struct address_space *mapping, long delta)
+{
+	atomic_long_add(delta, &nr_shadows);
+
+	if (delta > 0 && mapping->nrshadows == delta) {
+		spin_lock(&shadow_lock);
+		list_add_tail(&mapping->shadow_list, &shadow_mappings);
+		spin_unlock(&shadow_lock);
+	} else if (delta < 0 && !mapping->nrshadows) {
+		spin_lock(&shadow_lock);
+		list_del_init(&mapping->shadow_list);
+		spin_unlock(&shadow_lock);
+	}
+}
+
+static unsigned long shadows_excess(void)
+{
+	long excess = atomic_long_read(&nr_shadows) -
+		      global_page_state(NR_ACTIVE_FILE);
+
+	return max(excess, 0L);
+}
+
+static bool shadow_is_stale(void *shadow)
+{
+	unsigned long refault_distance;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &refault_distance);
+	return refault_distance > zone_page_state(zone, NR_ACTIVE_FILE);
+}
+
+/*
+ * Drop the stale shadow entries among the next @nr_to_scan slots of
+ * @mapping, starting where the last scan of it stopped.  Called with the
+ * mapping's tree_lock and shadow_lock held.  Returns the number of slots
+ * looked at.
+ */
+static unsigned long scan_mapping_shadows(struct address_space *mapping,
+					  unsigned long nr_to_scan)
+{
+	void **slots[PAGEVEC_SIZE];
+	pgoff_t indices[PAGEVEC_SIZE];
+	unsigned long scanned = 0;
+	long nr_dropped = 0;
+	unsigned int nr_found;
+	int i;
+
+	while (scanned < nr_to_scan) {
+		nr_found = radix_tree_gang_lookup_slot(&mapping->page_tree,
+				slots, indices, mapping->shadow_scan,
+				min_t(unsigned long, PAGEVEC_SIZE,
+				      nr_to_scan - scanned));
+		if (!nr_found) {
+			/* Start over from the beginning next time */
+			mapping->shadow_scan = 0;
+			break;
+		}
+		for (i = 0; i < nr_found; i++) {
+			void *entry;
+
+			entry = radix_tree_deref_slot_protected(slots[i],
+							&mapping->tree_lock);
+			if (!radix_tree_exceptional_entry(entry) ||
+			    !shadow_is_stale(entry))
+				continue;
+			radix_tree_delete(&mapping->page_tree, indices[i]);
+			nr_dropped++;
+		}
+		scanned += nr_found;
+		mapping->shadow_scan = indices[nr_found - 1] + 1;
+		if (!mapping->shadow_scan)
+			break;
+	}
+
+	mapping->nrshadows -= nr_dropped;
+	atomic_long_sub(nr_dropped, &nr_shadows);
+	if (!mapping->nrshadows)
+		list_del_init(&mapping->shadow_list);
+
+	return scanned;
+}
+
+static int shrink_shadows(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	unsigned long nr_to_scan = sc->nr_to_scan;
+	struct address_space *mapping;
+	unsigned long scanned;
+
+	if (!nr_to_scan)
+		goto out;
+
+	/*
+	 * A mapping is taken off the list, under shadow_lock, before its
+	 * inode can be freed, so holding shadow_lock keeps it around.  The
+	 * lock order is tree_lock first, hence the trylock.
+	 */
+	spin_lock_irq(&shadow_lock);
+	while (nr_to_scan && shadows_excess() &&
+	       !list_empty(&shadow_mappings)) {
+		mapping = list_first_entry(&shadow_mappings,
+					   struct address_space, shadow_list);
+		list_move_tail(&mapping->shadow_list, &shadow_mappings);
+
+		scanned = 1;
+		if (spin_trylock(&mapping->tree_lock)) {
+			scanned = max(scan_mapping_shadows(mapping, nr_to_scan),
+				      1UL);
+			spin_unlock(&mapping->tree_lock);
+		}
+		nr_to_scan -= min(scanned, nr_to_scan);
+	}
+	spin_unlock_irq(&shadow_lock);
+out:
+	return min_t(unsigned long, shadows_excess(), INT_MAX);
+}
+
+static struct shrinker shadow_shrinker = {
+	.shrink = shrink_shadows,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static int __init workingset_init(void)
+{
+	register_shrinker(&shadow_shrinker);
+	return 0;
+}
+module_init(workingset_init);
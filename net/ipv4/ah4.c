@@ -413,6 +413,27 @@ static void ah4_err(struct sk_buff *skb, u32 info)
 	xfrm_state_put(x);
 }
 
+/*
+ * With xfrm_async_crypto set, wrap the hash in cryptd so that the
+ * packets are processed by the crypto workqueue rather than in softirq.
+ */
+static struct crypto_ahash *ah_alloc_ahash(struct xfrm_state *x,
+					   const char *alg_name)
+{
+	char cryptd_name[CRYPTO_MAX_ALG_NAME];
+	struct crypto_ahash *ahash;
+
+	if (xs_net(x)->xfrm.sysctl_async_crypto &&
+	    snprintf(cryptd_name, CRYPTO_MAX_ALG_NAME, "cryptd(%s)",
+		     alg_name) < CRYPTO_MAX_ALG_NAME) {
+		ahash = crypto_alloc_ahash(cryptd_name, 0, 0);
+		if (!IS_ERR(ahash))
+			return ahash;
+	}
+
+	return crypto_alloc_ahash(alg_name, 0, 0);
+}
+
 static int ah_init_state(struct xfrm_state *x)
 {
 	struct ah_data *ahp = NULL;
@@ -429,7 +450,7 @@ static int ah_init_state(struct xfrm_state *x)
 	if (!ahp)
 		return -ENOMEM;
 
-	ahash = crypto_alloc_ahash(x->aalg->alg_name, 0, 0);
+	ahash = ah_alloc_ahash(x, x->aalg->alg_name);
 	if (IS_ERR(ahash))
 		goto error;
 
@@ -512,13 +512,34 @@ static void esp_destroy(struct xfrm_state *x)
 	kfree(esp);
 }
 
+/*
+ * With xfrm_async_crypto set, wrap the transform in cryptd so that the
+ * packets are processed by the crypto workqueue rather than in softirq.
+ */
+static struct crypto_aead *esp_alloc_aead(struct xfrm_state *x,
+					  const char *alg_name)
+{
+	char cryptd_name[CRYPTO_MAX_ALG_NAME];
+	struct crypto_aead *aead;
+
+	if (xs_net(x)->xfrm.sysctl_async_crypto &&
+	    snprintf(cryptd_name, CRYPTO_MAX_ALG_NAME, "cryptd(%s)",
+		     alg_name) < CRYPTO_MAX_ALG_NAME) {
+		aead = crypto_alloc_aead(cryptd_name, 0, 0);
+		if (!IS_ERR(aead))
+			return aead;
+	}
+
+	return crypto_alloc_aead(alg_name, 0, 0);
+}
+
 static int esp_init_aead(struct xfrm_state *x)
 {
 	struct esp_data *esp = x->data;
 	struct crypto_aead *aead;
 	int err;
 
-	aead = crypto_alloc_aead(x->aead->alg_name, 0, 0);
+	aead = esp_alloc_aead(x, x->aead->alg_name);
 	err = PTR_ERR(aead);
 	if (IS_ERR(aead))
 		goto error;
@@ -570,7 +591,7 @@ static int esp_init_authenc(struct xfrm_state *x)
 			goto error;
 	}
 
-	aead = crypto_alloc_aead(authenc_name, 0, 0);
+	aead = esp_alloc_aead(x, authenc_name);
 	err = PTR_ERR(aead);
 	if (IS_ERR(aead))
 		goto error;
@@ -15,11 +15,14 @@
 #define DEBUG
 
 #include <linux/file.h>
+#include <linux/hash.h>
 #include <linux/inetdevice.h>
 #include <linux/module.h>
 #include <linux/netfilter/x_tables.h>
 #include <linux/netfilter/xt_qtaguid.h>
+#include <linux/rculist.h>
 #include <linux/skbuff.h>
+#include <linux/vmalloc.h>
 #include <linux/workqueue.h>
 #include <net/addrconf.h>
 #include <net/sock.h>
@@ -45,6 +48,7 @@ static unsigned int proc_iface_perms = S_IRUGO;
 module_param_named(iface_perms, proc_iface_perms, uint, S_IRUGO | S_IWUSR);
 
 static struct proc_dir_entry *xt_qtaguid_stats_file;
+static struct proc_dir_entry *xt_qtaguid_stats_bin_file;
 static unsigned int proc_stats_perms = S_IRUGO;
 module_param_named(stats_perms, proc_stats_perms, uint, S_IRUGO | S_IWUSR);
 
@@ -178,15 +182,19 @@ static struct proc_dir_entry *iface_stat_all_procfile;
  * qtaguid_mt()
  *   account_for_uid()
  *     if_tag_stat_update()
- *       get_sock_stat()
- *         sock_tag_list_lock
- *       struct iface_stat->tag_stat_list_lock
- *         tag_stat_update()
- *           get_active_counter_set()
- *             tag_counter_set_list_lock
+ *       rcu_read_lock()
+ *         (iface_stat_list)
+ *         get_sock_stat()
+ *           (sock_tag_hash)
+ *         sock_tag_read()
+ *           (struct sock_tag->tag_seq)
+ *         (struct iface_stat->tag_stat_hash)
  *         tag_stat_update()
  *           get_active_counter_set()
- *             tag_counter_set_list_lock
+ *             (tag_counter_set_hash)
+ *         Only when the tag_stat does not exist yet:
+ *         struct iface_stat->tag_stat_list_lock
+ *           tag_stat_update()
  *
  *
  * qtaguid_ctrl_parse()
@@ -215,9 +223,11 @@ static LIST_HEAD(iface_stat_list);
 static DEFINE_SPINLOCK(iface_stat_list_lock);
 
 static struct rb_root sock_tag_tree = RB_ROOT;
+static struct hlist_head sock_tag_hash[1 << SOCK_TAG_HASH_BITS];
 static DEFINE_SPINLOCK(sock_tag_list_lock);
 
 static struct rb_root tag_counter_set_tree = RB_ROOT;
+static struct hlist_head tag_counter_set_hash[1 << TAG_COUNTER_SET_HASH_BITS];
 static DEFINE_SPINLOCK(tag_counter_set_list_lock);
 
 static struct rb_root uid_tag_data_tree = RB_ROOT;
@@ -227,6 +237,13 @@ static struct rb_root proc_qtu_data_tree = RB_ROOT;
 /* No proc_qtu_data_tree_lock; use uid_tag_data_tree_lock */
 
 static struct qtaguid_event_counts qtu_events;
+
+/*
+ * Generation of the tag stats, advanced by every read of stats_bin.
+ * Written under iface_stat_list_lock, read locklessly by the packet path.
+ * Starts at 1 so that generation 0 can ask for everything.
+ */
+static unsigned long qtu_stats_gen = 1;
 /*----------------------------------------------*/
 static bool can_manipulate_uids(void)
 {
@@ -331,6 +348,40 @@ static void tag_stat_tree_insert(struct tag_stat *data, struct rb_root *root)
 	tag_node_tree_insert(&data->tn, root);
 }
 
+/* Caller must hold iface_entry->tag_stat_list_lock */
+static void tag_stat_link(struct tag_stat *data, struct iface_stat *iface_entry)
+{
+	tag_stat_tree_insert(data, &iface_entry->tag_stat_tree);
+	hlist_add_head_rcu(&data->hash_node,
+			   &iface_entry->tag_stat_hash[
+				   hash_64(data->tn.tag, TAG_STAT_HASH_BITS)]);
+}
+
+/* Caller must hold iface_entry->tag_stat_list_lock */
+static void tag_stat_unlink(struct tag_stat *data,
+			    struct iface_stat *iface_entry)
+{
+	rb_erase(&data->tn.node, &iface_entry->tag_stat_tree);
+	hlist_del_rcu(&data->hash_node);
+}
+
+/* Caller must hold rcu_read_lock() */
+static struct tag_stat *tag_stat_hash_search(struct iface_stat *iface_entry,
+					     tag_t tag)
+{
+	struct tag_stat *ts_entry;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry_rcu(ts_entry, pos,
+				 &iface_entry->tag_stat_hash[
+					 hash_64(tag, TAG_STAT_HASH_BITS)],
+				 hash_node) {
+		if (ts_entry->tn.tag == tag)
+			return ts_entry;
+	}
+	return NULL;
+}
+
 static struct tag_stat *tag_stat_tree_search(struct rb_root *root, tag_t tag)
 {
 	struct tag_node *node = tag_node_tree_search(root, tag);
@@ -343,6 +394,26 @@ static void tag_counter_set_tree_insert(struct tag_counter_set *data,
 					struct rb_root *root)
 {
 	tag_node_tree_insert(&data->tn, root);
+	hlist_add_head_rcu(&data->hash_node,
+			   &tag_counter_set_hash[
+				   hash_64(data->tn.tag,
+					   TAG_COUNTER_SET_HASH_BITS)]);
+}
+
+/* Caller must hold rcu_read_lock() */
+static struct tag_counter_set *tag_counter_set_hash_search(tag_t tag)
+{
+	struct tag_counter_set *tcs;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry_rcu(tcs, pos,
+				 &tag_counter_set_hash[
+					 hash_64(tag, TAG_COUNTER_SET_HASH_BITS)],
+				 hash_node) {
+		if (tcs->tn.tag == tag)
+			return tcs;
+	}
+	return NULL;
 }
 
 static struct tag_counter_set *tag_counter_set_tree_search(struct rb_root *root,
@@ -408,6 +479,26 @@ static void sock_tag_tree_insert(struct sock_tag *data, struct rb_root *root)
 	rb_insert_color(&data->sock_node, root);
 }
 
+static struct hlist_head *sock_tag_hash_head(const struct sock *sk)
+{
+	return &sock_tag_hash[hash_ptr((void *)sk, SOCK_TAG_HASH_BITS)];
+}
+
+/* Caller must hold sock_tag_list_lock */
+static void sock_tag_link(struct sock_tag *st_entry)
+{
+	sock_tag_tree_insert(st_entry, &sock_tag_tree);
+	hlist_add_head_rcu(&st_entry->hash_node,
+			   sock_tag_hash_head(st_entry->sk));
+}
+
+/* Caller must hold sock_tag_list_lock */
+static void sock_tag_unlink(struct sock_tag *st_entry)
+{
+	rb_erase(&st_entry->sock_node, &sock_tag_tree);
+	hlist_del_rcu(&st_entry->hash_node);
+}
+
 static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 {
 	struct rb_node *node;
@@ -424,7 +515,8 @@ static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 			 get_uid_from_tag(st_entry->tag));
 		rb_erase(&st_entry->sock_node, st_to_free_tree);
 		sockfd_put(st_entry->socket);
-		kfree(st_entry);
+		/* The packet path might still be looking at it */
+		kfree_rcu(st_entry, rcu);
 	}
 }
 
@@ -745,17 +837,18 @@ static int get_active_counter_set(tag_t tag)
 		 tag, get_uid_from_tag(tag));
 	/* For now we only handle UID tags for active sets */
 	tag = get_utag_from_tag(tag);
-	spin_lock_bh(&tag_counter_set_list_lock);
-	tcs = tag_counter_set_tree_search(&tag_counter_set_tree, tag);
+	rcu_read_lock();
+	tcs = tag_counter_set_hash_search(tag);
 	if (tcs)
-		active_set = tcs->active_set;
-	spin_unlock_bh(&tag_counter_set_list_lock);
+		active_set = ACCESS_ONCE(tcs->active_set);
+	rcu_read_unlock();
 	return active_set;
 }
 
 /*
  * Find the entry for tracking the specified interface.
- * Caller must hold iface_stat_list_lock
+ * Caller must hold iface_stat_list_lock or rcu_read_lock().
+ * Entries are never removed from the list.
  */
 static struct iface_stat *get_iface_entry(const char *ifname)
 {
@@ -768,7 +861,7 @@ static struct iface_stat *get_iface_entry(const char *ifname)
 	}
 
 	/* Iterate over interfaces */
-	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
 		if (!strcmp(ifname, iface_entry->ifname))
 			goto done;
 	}
@@ -923,6 +1016,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	}
 	spin_lock_init(&new_iface->tag_stat_list_lock);
 	new_iface->tag_stat_tree = RB_ROOT;
+	/* kzalloc()ed: the tag_stat_hash heads are already empty */
 	_iface_stat_set_active(new_iface, net_dev, true);
 
 	/*
@@ -941,7 +1035,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	isw->iface_entry = new_iface;
 	INIT_WORK(&isw->iface_work, iface_create_proc_worker);
 	schedule_work(&isw->iface_work);
-	list_add(&new_iface->list, &iface_stat_list);
+	list_add_rcu(&new_iface->list, &iface_stat_list);
 	return new_iface;
 }
 
@@ -1131,22 +1225,45 @@ static struct sock_tag *get_sock_stat_nl(const struct sock *sk)
 	return sock_tag_tree_search(&sock_tag_tree, sk);
 }
 
+/* Caller must hold rcu_read_lock() */
 static struct sock_tag *get_sock_stat(const struct sock *sk)
 {
 	struct sock_tag *sock_tag_entry;
+	struct hlist_node *pos;
 	MT_DEBUG("qtaguid: get_sock_stat(sk=%p)\n", sk);
 	if (!sk)
 		return NULL;
-	spin_lock_bh(&sock_tag_list_lock);
-	sock_tag_entry = get_sock_stat_nl(sk);
-	spin_unlock_bh(&sock_tag_list_lock);
-	return sock_tag_entry;
+	hlist_for_each_entry_rcu(sock_tag_entry, pos, sock_tag_hash_head(sk),
+				 hash_node) {
+		if (sock_tag_entry->sk == sk)
+			return sock_tag_entry;
+	}
+	return NULL;
 }
 
+/* A 64-bit tag can be torn on 32-bit CPUs, so retry if it was retagged */
+static tag_t sock_tag_read(const struct sock_tag *sock_tag_entry)
+{
+	unsigned int seq;
+	tag_t tag;
+
+	do {
+		seq = read_seqcount_begin(&sock_tag_entry->tag_seq);
+		tag = sock_tag_entry->tag;
+	} while (read_seqcount_retry(&sock_tag_entry->tag_seq, seq));
+
+	return tag;
+}
+
+/* Called from the match, with BHs disabled */
 static void
-data_counters_update(struct data_counters *dc, int set,
+data_counters_update(struct data_counters_cpu *pcpu, int set,
 		     enum ifs_tx_rx direction, int proto, int bytes)
 {
+	struct data_counters_cpu *c = &pcpu[smp_processor_id()];
+	struct data_counters *dc = &c->dc;
+
+	u64_stats_update_begin(&c->syncp);
 	switch (proto) {
 	case IPPROTO_TCP:
 		dc_add_byte_packets(dc, set, direction, IFS_TCP, bytes, 1);
@@ -1160,6 +1277,7 @@ data_counters_update(struct data_counters *dc, int set,
 				    1);
 		break;
 	}
+	u64_stats_update_end(&c->syncp);
 }
 
 /*
@@ -1216,6 +1334,16 @@ static void iface_stat_update(struct net_device *net_dev, bool stash_only)
 	spin_unlock_bh(&iface_stat_list_lock);
 }
 
+/* Mark the tag_stat as changed in the current stats generation */
+static inline void tag_stat_touch(struct tag_stat *ts)
+{
+	unsigned long gen = ACCESS_ONCE(qtu_stats_gen);
+
+	/* Only write to the shared part of the tag_stat once per poll */
+	if (ts->gen != gen)
+		ts->gen = gen;
+}
+
 static void tag_stat_update(struct tag_stat *tag_entry,
 			enum ifs_tx_rx direction, int proto, int bytes)
 {
@@ -1225,11 +1353,14 @@ static void tag_stat_update(struct tag_stat *tag_entry,
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
-	data_counters_update(&tag_entry->counters, active_set, direction,
+	data_counters_update(tag_entry->counters, active_set, direction,
 			     proto, bytes);
-	if (tag_entry->parent_counters)
-		data_counters_update(tag_entry->parent_counters, active_set,
+	tag_stat_touch(tag_entry);
+	if (tag_entry->parent) {
+		data_counters_update(tag_entry->parent->counters, active_set,
 				     direction, proto, bytes);
+		tag_stat_touch(tag_entry->parent);
+	}
 }
 
 /*
@@ -1237,20 +1368,28 @@ static void tag_stat_update(struct tag_stat *tag_entry,
  * the interface.
  * iface_entry->tag_stat_list_lock should be held.
  */
-static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
-					   tag_t tag)
+static struct tag_stat *
+create_if_tag_stat(struct iface_stat *iface_entry, tag_t tag,
+		   struct tag_stat *parent)
 {
 	struct tag_stat *new_tag_stat_entry = NULL;
 	IF_DEBUG("qtaguid: iface_stat: %s(): ife=%p tag=0x%llx"
 		 " (uid=%u)\n", __func__,
 		 iface_entry, tag, get_uid_from_tag(tag));
-	new_tag_stat_entry = kzalloc(sizeof(*new_tag_stat_entry), GFP_ATOMIC);
+	/* alloc_percpu() can sleep, so the per-cpu counters are inline. */
+	new_tag_stat_entry = kzalloc(sizeof(*new_tag_stat_entry) +
+				     nr_cpu_ids *
+				     sizeof(struct data_counters_cpu),
+				     GFP_ATOMIC);
 	if (!new_tag_stat_entry) {
 		pr_err("qtaguid: iface_stat: tag stat alloc failed\n");
 		goto done;
 	}
 	new_tag_stat_entry->tn.tag = tag;
-	tag_stat_tree_insert(new_tag_stat_entry, &iface_entry->tag_stat_tree);
+	/* Set up before the packet path can find it */
+	new_tag_stat_entry->parent = parent;
+	new_tag_stat_entry->gen = ACCESS_ONCE(qtu_stats_gen);
+	tag_stat_link(new_tag_stat_entry, iface_entry);
 done:
 	return new_tag_stat_entry;
 }
@@ -1262,7 +1401,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	struct tag_stat *tag_stat_entry;
 	tag_t tag, acct_tag;
 	tag_t uid_tag;
-	struct data_counters *uid_tag_counters;
+	struct tag_stat *uid_tag_stat;
 	struct sock_tag *sock_tag_entry;
 	struct iface_stat *iface_entry;
 	struct tag_stat *new_tag_stat;
@@ -1270,9 +1409,14 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
 		 ifname, uid, sk, direction, proto, bytes);
 
-
+	/*
+	 * Everything looked up here is freed after an RCU grace period,
+	 * so the common case of an existing tag_stat takes no locks.
+	 */
+	rcu_read_lock();
 	iface_entry = get_iface_entry(ifname);
 	if (!iface_entry) {
+		rcu_read_unlock();
 		pr_err("qtaguid: iface_stat: stat_update() %s not found\n",
 		       ifname);
 		return;
@@ -1288,7 +1432,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	 */
 	sock_tag_entry = get_sock_stat(sk);
 	if (sock_tag_entry) {
-		tag = sock_tag_entry->tag;
+		tag = sock_tag_read(sock_tag_entry);
 		acct_tag = get_atag_from_tag(tag);
 		uid_tag = get_utag_from_tag(tag);
 	} else {
@@ -1299,21 +1443,29 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	MT_DEBUG("qtaguid: iface_stat: stat_update(): "
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
-	/* Loop over tag list under this interface for {acct_tag,uid_tag} */
-	spin_lock_bh(&iface_entry->tag_stat_list_lock);
 
-	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
-					      tag);
+	tag_stat_entry = tag_stat_hash_search(iface_entry, tag);
 	if (tag_stat_entry) {
 		/*
 		 * Updating the {acct_tag, uid_tag} entry handles both stats:
 		 * {0, uid_tag} will also get updated.
 		 */
 		tag_stat_update(tag_stat_entry, direction, proto, bytes);
-		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+		rcu_read_unlock();
 		return;
 	}
 
+	/* Loop over tag list under this interface for {acct_tag,uid_tag} */
+	spin_lock_bh(&iface_entry->tag_stat_list_lock);
+
+	/* Someone else might have created it since the lookup above. */
+	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
+					      tag);
+	if (tag_stat_entry) {
+		tag_stat_update(tag_stat_entry, direction, proto, bytes);
+		goto unlock;
+	}
+
 	/* Loop over tag list under this interface for {0,uid_tag} */
 	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
 					      uid_tag);
@@ -1323,18 +1475,24 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 * No parent counters. So
 		 *  - No {0, uid_tag} stats and no {acc_tag, uid_tag} stats.
 		 */
-		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
-		uid_tag_counters = &new_tag_stat->counters;
+		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag, NULL);
+		if (!new_tag_stat)
+			goto unlock;
+		uid_tag_stat = new_tag_stat;
 	} else {
-		uid_tag_counters = &tag_stat_entry->counters;
+		uid_tag_stat = tag_stat_entry;
 	}
 
 	if (acct_tag) {
-		new_tag_stat = create_if_tag_stat(iface_entry, tag);
-		new_tag_stat->parent_counters = uid_tag_counters;
+		new_tag_stat = create_if_tag_stat(iface_entry, tag,
+						  uid_tag_stat);
+		if (!new_tag_stat)
+			goto unlock;
 	}
 	tag_stat_update(new_tag_stat, direction, proto, bytes);
+unlock:
 	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+	rcu_read_unlock();
 }
 
 static int iface_netdev_event_handler(struct notifier_block *nb,
@@ -1913,7 +2071,7 @@ static int ctrl_cmd_delete(const char *input)
 			 input, st_entry->tag, entry_uid);
 
 		if (!acct_tag || st_entry->tag == tag) {
-			rb_erase(&st_entry->sock_node, &sock_tag_tree);
+			sock_tag_unlink(st_entry);
 			/* Can't sockfd_put() within spinlock, do it later. */
 			sock_tag_tree_insert(st_entry, &st_to_free_tree);
 			tr_entry = lookup_tag_ref(st_entry->tag, NULL);
@@ -1946,7 +2104,8 @@ static int ctrl_cmd_delete(const char *input)
 			 get_uid_from_tag(tcs_entry->tn.tag),
 			 tcs_entry->active_set);
 		rb_erase(&tcs_entry->tn.node, &tag_counter_set_tree);
-		kfree(tcs_entry);
+		hlist_del_rcu(&tcs_entry->hash_node);
+		kfree_rcu(tcs_entry, rcu);
 	}
 	spin_unlock_bh(&tag_counter_set_list_lock);
 
@@ -1975,9 +2134,8 @@ static int ctrl_cmd_delete(const char *input)
 					 input, iface_entry->ifname,
 					 get_atag_from_tag(ts_entry->tn.tag),
 					 entry_uid);
-				rb_erase(&ts_entry->tn.node,
-					 &iface_entry->tag_stat_tree);
-				kfree(ts_entry);
+				tag_stat_unlink(ts_entry, iface_entry);
+				kfree_rcu(ts_entry, rcu);
 			}
 		}
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
@@ -2158,7 +2316,9 @@ static int ctrl_cmd_tag(const char *input)
 		BUG_ON(IS_ERR_OR_NULL(prev_tag_ref_entry));
 		BUG_ON(prev_tag_ref_entry->num_sock_tags <= 0);
 		prev_tag_ref_entry->num_sock_tags--;
+		write_seqcount_begin(&sock_tag_entry->tag_seq);
 		sock_tag_entry->tag = full_tag;
+		write_seqcount_end(&sock_tag_entry->tag_seq);
 	} else {
 		CT_DEBUG("qtaguid: ctrl_tag(%s): newtag for sk=%p\n",
 			 input, el_socket->sk);
@@ -2175,6 +2335,7 @@ static int ctrl_cmd_tag(const char *input)
 		sock_tag_entry->sk = el_socket->sk;
 		sock_tag_entry->socket = el_socket;
 		sock_tag_entry->pid = current->tgid;
+		seqcount_init(&sock_tag_entry->tag_seq);
 		sock_tag_entry->tag = combine_atag_with_uid(acct_tag,
 							    uid);
 		spin_lock_bh(&uid_tag_data_tree_lock);
@@ -2197,7 +2358,7 @@ static int ctrl_cmd_tag(const char *input)
 				 &pqd_entry->sock_tag_list);
 		spin_unlock_bh(&uid_tag_data_tree_lock);
 
-		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
+		sock_tag_link(sock_tag_entry);
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
 	spin_unlock_bh(&sock_tag_list_lock);
@@ -2261,7 +2422,7 @@ static int ctrl_cmd_untag(const char *input)
 	 * The socket already belongs to the current process
 	 * so it can do whatever it wants to it.
 	 */
-	rb_erase(&sock_tag_entry->sock_node, &sock_tag_tree);
+	sock_tag_unlink(sock_tag_entry);
 
 	tag_ref_entry = lookup_tag_ref(sock_tag_entry->tag, &utd_entry);
 	BUG_ON(!tag_ref_entry);
@@ -2298,7 +2459,7 @@ static int ctrl_cmd_untag(const char *input)
 		 atomic_long_read(&el_socket->file->f_count) - 1);
 	sockfd_put(el_socket);
 
-	kfree(sock_tag_entry);
+	kfree_rcu(sock_tag_entry, rcu);
 	atomic64_inc(&qtu_events.sockets_untagged);
 
 	return 0;
@@ -2374,6 +2535,8 @@ struct proc_print_info {
 	char **num_items_returned;
 	struct iface_stat *iface_entry;
 	struct tag_stat *ts_entry;
+	/* ts_entry's counters, folded once for all its counter sets */
+	struct data_counters counters;
 	int item_index;
 	int items_to_skip;
 	int char_count;
@@ -2382,7 +2545,7 @@ struct proc_print_info {
 static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 {
 	int len;
-	struct data_counters *cnts;
+	struct data_counters *cnts = &ppi->counters;
 
 	if (!ppi->item_index) {
 		if (ppi->item_index++ < ppi->items_to_skip)
@@ -2412,7 +2575,6 @@ static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 		}
 		if (ppi->item_index++ < ppi->items_to_skip)
 			return 0;
-		cnts = &ppi->ts_entry->counters;
 		len = snprintf(
 			ppi->outp, ppi->char_count,
 			"%d %s 0x%llx %u %u "
@@ -2524,6 +2686,8 @@ static int qtaguid_stats_proc_read(char *page, char **num_items_returned,
 		     node;
 		     node = rb_next(node)) {
 			ppi.ts_entry = rb_entry(node, struct tag_stat, tn.node);
+			data_counters_fold(&ppi.counters,
+					   ppi.ts_entry->counters);
 			if (!pp_sets(&ppi)) {
 				spin_unlock_bh(
 					&ppi.iface_entry->tag_stat_list_lock);
@@ -2539,6 +2703,140 @@ static int qtaguid_stats_proc_read(char *page, char **num_items_returned,
 	return ppi.outp - page;
 }
 
+/* Keep the kernel side buffer of a stats_bin read reasonable */
+#define STATS_BIN_MAX_READ (1 << 20)
+
+static void pp_stats_bin_rec(struct xt_qtaguid_stats_rec *rec,
+			     struct iface_stat *iface_entry,
+			     struct tag_stat *ts_entry,
+			     struct data_counters *cnts, int cnt_set)
+{
+	int proto;
+
+	BUILD_BUG_ON((int)IFS_MAX_PROTOS != (int)XT_QTAGUID_PROTO_MAX);
+	memset(rec, 0, sizeof(*rec));
+	strlcpy(rec->iface, iface_entry->ifname, sizeof(rec->iface));
+	rec->acct_tag = get_atag_from_tag(ts_entry->tn.tag);
+	rec->uid = get_uid_from_tag(ts_entry->tn.tag);
+	rec->cnt_set = cnt_set;
+	for (proto = 0; proto < IFS_MAX_PROTOS; proto++) {
+		rec->rx_bytes[proto] = cnts->bpc[cnt_set][IFS_RX][proto].bytes;
+		rec->rx_packets[proto] =
+			cnts->bpc[cnt_set][IFS_RX][proto].packets;
+		rec->tx_bytes[proto] = cnts->bpc[cnt_set][IFS_TX][proto].bytes;
+		rec->tx_packets[proto] =
+			cnts->bpc[cnt_set][IFS_TX][proto].packets;
+	}
+}
+
+/*
+ * Binary stats reader.
+ * The file position is the generation to report changes since: a read at
+ * position 0 returns all the tag stats, and leaves the position at the
+ * generation to pass next time, so that consecutive read()s only return
+ * what changed in between (pread() works too).
+ * Records carry absolute counter values, and one changed while a read is
+ * in progress can be reported again by the next one.
+ * Deleted tags are not reported.
+ * If the records don't all fit, none are returned and hdr.nr_total says
+ * how many there are, so that the caller can retry with a bigger buffer.
+ */
+static ssize_t qtaguid_stats_bin_read(struct file *file, char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	struct xt_qtaguid_stats_hdr *hdr;
+	struct xt_qtaguid_stats_rec *rec;
+	struct iface_stat *iface_entry;
+	struct data_counters cnts;
+	unsigned long since = *ppos;
+	unsigned int nr = 0, nr_total = 0, max_recs;
+	bool all = !*ppos;
+	size_t len;
+	void *kbuf;
+	int cnt_set;
+
+	if (count < sizeof(*hdr))
+		return -EINVAL;
+	count = min_t(size_t, count, STATS_BIN_MAX_READ);
+	max_recs = (count - sizeof(*hdr)) / sizeof(*rec);
+
+	kbuf = vmalloc(count);
+	if (!kbuf)
+		return -ENOMEM;
+	hdr = kbuf;
+	rec = kbuf + sizeof(*hdr);
+
+	/* From here on, updates belong to the next generation. */
+	spin_lock_bh(&iface_stat_list_lock);
+	hdr->generation = ++qtu_stats_gen;
+	spin_unlock_bh(&iface_stat_list_lock);
+	/*
+	 * The packet path updates the counters and tags the tag_stat with the
+	 * generation under rcu_read_lock(). Wait for the updates that might
+	 * still tag with the old generation, so that none are missed by both
+	 * this read and the next one.
+	 */
+	synchronize_rcu();
+
+	spin_lock_bh(&iface_stat_list_lock);
+	if (unlikely(module_passive))
+		goto unlock;
+	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+		struct rb_node *node;
+
+		spin_lock_bh(&iface_entry->tag_stat_list_lock);
+		for (node = rb_first(&iface_entry->tag_stat_tree);
+		     node;
+		     node = rb_next(node)) {
+			struct tag_stat *ts_entry;
+
+			ts_entry = rb_entry(node, struct tag_stat, tn.node);
+			if (!all && (long)(ts_entry->gen - since) < 0)
+				continue;
+			if (!can_read_other_uid_stats(
+				    get_uid_from_tag(ts_entry->tn.tag)))
+				continue;
+			nr_total += IFS_MAX_COUNTER_SETS;
+			if (nr + IFS_MAX_COUNTER_SETS > max_recs)
+				continue;
+			data_counters_fold(&cnts, ts_entry->counters);
+			for (cnt_set = 0; cnt_set < IFS_MAX_COUNTER_SETS;
+			     cnt_set++)
+				pp_stats_bin_rec(&rec[nr++], iface_entry,
+						 ts_entry, &cnts, cnt_set);
+		}
+		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+	}
+unlock:
+	spin_unlock_bh(&iface_stat_list_lock);
+
+	if (nr < nr_total)
+		nr = 0;
+	hdr->version = XT_QTAGUID_STATS_VERSION;
+	hdr->rec_size = sizeof(*rec);
+	hdr->nr_recs = nr;
+	hdr->nr_total = nr_total;
+	len = sizeof(*hdr) + nr * sizeof(*rec);
+
+	CT_DEBUG("qtaguid: stats_bin: since=%lu gen=%llu recs=%u/%u\n",
+		 since, hdr->generation, nr, nr_total);
+
+	if (copy_to_user(buf, kbuf, len)) {
+		vfree(kbuf);
+		return -EFAULT;
+	}
+	if (nr == nr_total)
+		*ppos = hdr->generation;
+	vfree(kbuf);
+	return len;
+}
+
+static const struct file_operations qtaguid_stats_bin_fops = {
+	.owner	= THIS_MODULE,
+	.read	= qtaguid_stats_bin_read,
+	.llseek	= default_llseek,
+};
+
 /*------------------------------------------*/
 static int qtudev_open(struct inode *inode, struct file *file)
 {
@@ -2656,7 +2954,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 		tr->num_sock_tags--;
 		free_tag_ref_from_utd_entry(tr, utd_entry);
 
-		rb_erase(&st_entry->sock_node, &sock_tag_tree);
+		sock_tag_unlink(st_entry);
 		list_del(&st_entry->list);
 		/* Can't sockfd_put() within spinlock, do it later. */
 		sock_tag_tree_insert(st_entry, &st_to_free_tree);
@@ -2736,8 +3034,20 @@ static int __init qtaguid_proc_register(struct proc_dir_entry **res_procdir)
 	 * TODO: add support counter hacking
 	 * xt_qtaguid_stats_file->write_proc = qtaguid_stats_proc_write;
 	 */
+
+	xt_qtaguid_stats_bin_file = proc_create("stats_bin", proc_stats_perms,
+						*res_procdir,
+						&qtaguid_stats_bin_fops);
+	if (!xt_qtaguid_stats_bin_file) {
+		pr_err("qtaguid: failed to create xt_qtaguid/stats_bin "
+			"file\n");
+		ret = -ENOMEM;
+		goto no_stats_bin_entry;
+	}
 	return 0;
 
+no_stats_bin_entry:
+	remove_proc_entry("stats", *res_procdir);
 no_stats_entry:
 	remove_proc_entry("ctrl", *res_procdir);
 no_ctrl_entry:
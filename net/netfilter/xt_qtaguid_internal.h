@@ -11,8 +11,15 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/cache.h>
+#include <linux/cpumask.h>
+#include <linux/list.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
+#include <linux/seqlock.h>
 #include <linux/spinlock_types.h>
+#include <linux/string.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -179,20 +186,74 @@ struct data_counters {
 	struct byte_packet_counters bpc[IFS_MAX_COUNTER_SETS][IFS_MAX_DIRECTIONS][IFS_MAX_PROTOS];
 };
 
+/*
+ * One CPU's share of the counters of a tag_stat.
+ * Only ever updated by its own CPU, from the match with BHs disabled.
+ * syncp lets readers get a consistent 64bit snapshot on 32bit SMP.
+ */
+struct data_counters_cpu {
+	struct data_counters dc;
+	struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
+/* Sum the per-cpu counters into *dc. */
+static inline void data_counters_fold(struct data_counters *dc,
+				      const struct data_counters_cpu *pcpu)
+{
+	int cpu, set, dir, proto;
+
+	memset(dc, 0, sizeof(*dc));
+	for_each_possible_cpu(cpu) {
+		const struct data_counters_cpu *c = &pcpu[cpu];
+		struct data_counters snap;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin(&c->syncp);
+			snap = c->dc;
+		} while (u64_stats_fetch_retry(&c->syncp, start));
+
+		for (set = 0; set < IFS_MAX_COUNTER_SETS; set++)
+			for (dir = 0; dir < IFS_MAX_DIRECTIONS; dir++)
+				for (proto = 0; proto < IFS_MAX_PROTOS;
+				     proto++) {
+					dc->bpc[set][dir][proto].bytes +=
+						snap.bpc[set][dir][proto].bytes;
+					dc->bpc[set][dir][proto].packets +=
+						snap.bpc[set][dir][proto].packets;
+				}
+	}
+}
+
 /* Generic X based nodes used as a base for rb_tree ops */
 struct tag_node {
 	struct rb_node node;
 	tag_t tag;
 };
 
+/*
+ * The rb_trees keep entries sorted for the proc readers and the ctrl
+ * commands, which hold the tree's lock.
+ * The per packet lookups instead go through hash tables of the same
+ * entries, under rcu_read_lock(). Entries are freed after a grace period.
+ */
+#define SOCK_TAG_HASH_BITS 8
+#define TAG_STAT_HASH_BITS 6
+#define TAG_COUNTER_SET_HASH_BITS 6
+
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
+	struct hlist_node hash_node;  /* in iface_stat.tag_stat_hash */
+	struct rcu_head rcu;
+	/* The stats generation of the last update, for the binary export */
+	unsigned long gen;
 	/*
 	 * If this tag is acct_tag based, we need to count against the
 	 * matching parent uid_tag.
 	 */
-	struct data_counters *parent_counters;
+	struct tag_stat *parent;
+	/* nr_cpu_ids entries, summed up with data_counters_fold() */
+	struct data_counters_cpu counters[0];
 };
 
 struct iface_stat {
@@ -218,6 +279,7 @@ struct iface_stat {
 	struct proc_dir_entry *proc_ptr;
 
 	struct rb_root tag_stat_tree;
+	struct hlist_head tag_stat_hash[1 << TAG_STAT_HASH_BITS];
 	spinlock_t tag_stat_list_lock;
 };
 
@@ -235,6 +297,8 @@ struct iface_stat_work {
  */
 struct sock_tag {
 	struct rb_node sock_node;
+	struct hlist_node hash_node;  /* in sock_tag_hash */
+	struct rcu_head rcu;
 	struct sock *sk;  /* Only used as a number, never dereferenced */
 	/* The socket is needed for sockfd_put() */
 	struct socket *socket;
@@ -242,6 +306,11 @@ struct sock_tag {
 	struct list_head list;   /* in proc_qtu_data.sock_tag_list */
 	pid_t pid;
 
+	/*
+	 * Retagging rewrites the tag in place under sock_tag_list_lock;
+	 * tag_seq lets the lockless readers see it whole.
+	 */
+	seqcount_t tag_seq;
 	tag_t tag;
 };
 
@@ -278,6 +347,8 @@ struct qtaguid_event_counts {
 /* Track the set active_set for the given tag. */
 struct tag_counter_set {
 	struct tag_node tn;
+	struct hlist_node hash_node;  /* in tag_counter_set_hash */
+	struct rcu_head rcu;
 	int active_set;
 };
 
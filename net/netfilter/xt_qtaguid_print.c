@@ -151,9 +151,10 @@ char *pp_tag_ref(struct tag_ref *tr)
 
 char *pp_tag_stat(struct tag_stat *ts)
 {
+	struct data_counters counters;
 	char *tn_str;
 	char *counters_str;
-	char *parent_counters_str;
+	char *parent_str;
 	char *res;
 
 	if (!ts) {
@@ -162,15 +163,17 @@ char *pp_tag_stat(struct tag_stat *ts)
 		return res;
 	}
 	tn_str = pp_tag_node(&ts->tn);
-	counters_str = pp_data_counters(&ts->counters, true);
-	parent_counters_str = pp_data_counters(ts->parent_counters, false);
+	data_counters_fold(&counters, ts->counters);
+	counters_str = pp_data_counters(&counters, true);
+	parent_str = ts->parent ? pp_tag_node(&ts->parent->tn) : NULL;
 	res = kasprintf(GFP_ATOMIC,
-			"tag_stat@%p{%s, counters=%s, parent_counters=%s}",
-			ts, tn_str, counters_str, parent_counters_str);
+			"tag_stat@%p{%s, gen=%lu, counters=%s, parent=%s}",
+			ts, tn_str, ts->gen, counters_str,
+			parent_str ? parent_str : "null");
 	_bug_on_err_or_null(res);
 	kfree(tn_str);
 	kfree(counters_str);
-	kfree(parent_counters_str);
+	kfree(parent_str);
 	return res;
 }
 